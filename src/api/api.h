@@ -1,6 +1,7 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include "core/hash.h"
@@ -36,6 +37,7 @@ extern const luaL_Reg lovrCylinderShape[];
 extern const luaL_Reg lovrDistanceJoint[];
 extern const luaL_Reg lovrFont[];
 extern const luaL_Reg lovrHingeJoint[];
+extern const luaL_Reg lovrJob[];
 extern const luaL_Reg lovrMat4[];
 extern const luaL_Reg lovrMaterial[];
 extern const luaL_Reg lovrMesh[];
@@ -62,6 +64,7 @@ extern const luaL_Reg lovrWorld[];
 // Enums
 extern const char* ArcModes[];
 extern const char* AttributeTypes[];
+extern const char* BatchMisses[];
 extern const char* BlendAlphaModes[];
 extern const char* BlendModes[];
 extern const char* BlockTypes[];
@@ -75,6 +78,7 @@ extern const char* DrawModes[];
 extern const char* DrawStyles[];
 extern const char* EventTypes[];
 extern const char* FilterModes[];
+extern const char* FlushReasons[];
 extern const char* HeadsetDrivers[];
 extern const char* HeadsetOrigins[];
 extern const char* HorizontalAligns[];
@@ -86,6 +90,7 @@ extern const char* ShaderTypes[];
 extern const char* ShapeTypes[];
 extern const char* SourceTypes[];
 extern const char* StencilActions[];
+extern const char* StreamTypes[];
 extern const char* TextureFormats[];
 extern const char* TextureTypes[];
 extern const char* TimeUnits[];
@@ -149,6 +154,15 @@ int luax_pushvariant(lua_State* L, struct Variant* variant);
 void* luax_readfile(const char* filename, size_t* bytesRead);
 #endif
 
+#ifdef LOVR_ENABLE_THREAD
+struct Job;
+void luax_checktimeout(lua_State* L, int index, double* timeout);
+int luax_submitjob(lua_State* L, const char* code, int index, lua_CFunction finalize);
+void luax_finalizejobs(lua_State* L, double budget);
+bool luax_isjobready(struct Job* job);
+int luax_awaitjob(lua_State* L, struct Job* job);
+#endif
+
 #ifdef LOVR_ENABLE_GRAPHICS
 struct Attachment;
 struct Texture;
@@ -122,6 +122,24 @@ static int l_lovrDataNewTextureData(lua_State* L) {
   return 1;
 }
 
+#ifdef LOVR_ENABLE_THREAD
+
+// The async variants run the regular constructors on a worker thread, returning a Job
+
+static int l_lovrDataNewModelDataAsync(lua_State* L) {
+  return luax_submitjob(L, "return require('lovr.data').newModelData(...)", 1, NULL);
+}
+
+static int l_lovrDataNewSoundDataAsync(lua_State* L) {
+  return luax_submitjob(L, "return require('lovr.data').newSoundData(...)", 1, NULL);
+}
+
+static int l_lovrDataNewTextureDataAsync(lua_State* L) {
+  return luax_submitjob(L, "return require('lovr.data').newTextureData(...)", 1, NULL);
+}
+
+#endif
+
 static const luaL_Reg lovrData[] = {
   { "newBlob", l_lovrDataNewBlob },
   { "newAudioStream", l_lovrDataNewAudioStream },
@@ -129,6 +147,11 @@ static const luaL_Reg lovrData[] = {
   { "newRasterizer", l_lovrDataNewRasterizer },
   { "newSoundData", l_lovrDataNewSoundData },
   { "newTextureData", l_lovrDataNewTextureData },
+#ifdef LOVR_ENABLE_THREAD
+  { "newModelDataAsync", l_lovrDataNewModelDataAsync },
+  { "newSoundDataAsync", l_lovrDataNewSoundDataAsync },
+  { "newTextureDataAsync", l_lovrDataNewTextureDataAsync },
+#endif
   { NULL, NULL }
 };
 
@@ -1,6 +1,7 @@
 #include "api.h"
 #include "event/event.h"
 #include "thread/thread.h"
+#include "core/arr.h"
 #include "core/os.h"
 #include "core/ref.h"
 #include "core/util.h"
@@ -17,6 +18,280 @@ const char* EventTypes[] = {
 
 static LOVR_THREAD_LOCAL int pollRef;
 
+static bool luax_checkobject(lua_State* L, int index, VariantObject* object) {
+  if (!lua_getmetatable(L, index)) {
+    return false;
+  }
+
+  lua_pushliteral(L, "__name");
+  lua_rawget(L, -2);
+  object->type = (const char*) lua_touserdata(L, -1);
+  lua_pop(L, 1);
+
+  lua_pushliteral(L, "__destructor");
+  lua_rawget(L, -2);
+  object->destructor = (void (*)(void*)) lua_tocfunction(L, -1);
+  lua_pop(L, 1);
+
+  lua_pop(L, 1);
+
+  if (!object->type || !object->destructor) {
+    return false;
+  }
+
+  Proxy* proxy = lua_touserdata(L, index);
+  object->pointer = proxy->object;
+  return true;
+}
+
+// Table encoding.  Every value starts with a tag byte.  Tables store their array part first (as
+// raw doubles when it only contains numbers), followed by the remaining key/value pairs.  Tables
+// are numbered in the order they're first seen, and later occurrences of the same table (including
+// cycles) are written as references to that number.  Multibyte values are unaligned.
+
+enum {
+  TAG_NIL,
+  TAG_FALSE,
+  TAG_TRUE,
+  TAG_NUMBER,
+  TAG_STRING,
+  TAG_OBJECT,
+  TAG_TABLE,
+  TAG_REFERENCE
+};
+
+typedef struct {
+  arr_t(char) bytes;
+  arr_t(VariantObject) objects;
+  uint32_t tableCount;
+  int seen;
+  int badType;
+} Encoder;
+
+static void writeBytes(Encoder* encoder, const void* data, size_t size) {
+  arr_append(&encoder->bytes, (const char*) data, size);
+}
+
+static void writeTag(Encoder* encoder, char tag) {
+  arr_push(&encoder->bytes, tag);
+}
+
+static void writeU32(Encoder* encoder, uint32_t x) {
+  writeBytes(encoder, &x, sizeof(x));
+}
+
+static void writeNumber(Encoder* encoder, double x) {
+  writeBytes(encoder, &x, sizeof(x));
+}
+
+static bool writeValue(lua_State* L, int index, Encoder* encoder);
+
+static bool writeTable(lua_State* L, int index, Encoder* encoder) {
+  lua_pushvalue(L, index);
+  lua_rawget(L, encoder->seen);
+  if (!lua_isnil(L, -1)) {
+    writeTag(encoder, TAG_REFERENCE);
+    writeU32(encoder, (uint32_t) lua_tonumber(L, -1));
+    lua_pop(L, 1);
+    return true;
+  }
+  lua_pop(L, 1);
+
+  luaL_checkstack(L, 8, "Table is nested too deeply to be sent");
+  lua_pushvalue(L, index);
+  lua_pushnumber(L, encoder->tableCount++);
+  lua_rawset(L, encoder->seen);
+
+  uint32_t length = luax_len(L, index);
+  bool packed = true;
+  for (uint32_t i = 1; i <= length && packed; i++) {
+    lua_rawgeti(L, index, i);
+    packed = lua_type(L, -1) == LUA_TNUMBER;
+    lua_pop(L, 1);
+  }
+
+  writeTag(encoder, TAG_TABLE);
+  writeU32(encoder, length);
+  writeTag(encoder, packed);
+  arr_reserve(&encoder->bytes, encoder->bytes.length + (packed ? length * sizeof(double) : length));
+  for (uint32_t i = 1; i <= length; i++) {
+    lua_rawgeti(L, index, i);
+    if (packed) {
+      writeNumber(encoder, lua_tonumber(L, -1));
+    } else if (!writeValue(L, lua_gettop(L), encoder)) {
+      return false;
+    }
+    lua_pop(L, 1);
+  }
+
+  size_t pairCountOffset = encoder->bytes.length;
+  uint32_t pairCount = 0;
+  writeU32(encoder, 0);
+
+  lua_pushnil(L);
+  while (lua_next(L, index) != 0) {
+    int key = lua_gettop(L) - 1;
+    if (lua_type(L, key) == LUA_TNUMBER) {
+      double number = lua_tonumber(L, key);
+      if (number >= 1 && number <= length && number == (uint32_t) number) {
+        lua_pop(L, 1);
+        continue;
+      }
+    }
+
+    if (!writeValue(L, key, encoder) || !writeValue(L, key + 1, encoder)) {
+      return false;
+    }
+
+    pairCount++;
+    lua_pop(L, 1);
+  }
+
+  memcpy(encoder->bytes.data + pairCountOffset, &pairCount, sizeof(pairCount));
+  return true;
+}
+
+static bool writeValue(lua_State* L, int index, Encoder* encoder) {
+  switch (lua_type(L, index)) {
+    case LUA_TNIL: writeTag(encoder, TAG_NIL); return true;
+    case LUA_TBOOLEAN: writeTag(encoder, lua_toboolean(L, index) ? TAG_TRUE : TAG_FALSE); return true;
+    case LUA_TNUMBER: writeTag(encoder, TAG_NUMBER); writeNumber(encoder, lua_tonumber(L, index)); return true;
+    case LUA_TSTRING: {
+      size_t length;
+      const char* string = lua_tolstring(L, index, &length);
+      writeTag(encoder, TAG_STRING);
+      writeU32(encoder, (uint32_t) length);
+      writeBytes(encoder, string, length);
+      return true;
+    }
+    case LUA_TUSERDATA: {
+      VariantObject object;
+      if (!luax_checkobject(L, index, &object)) break;
+      writeTag(encoder, TAG_OBJECT);
+      writeU32(encoder, (uint32_t) encoder->objects.length);
+      arr_push(&encoder->objects, object);
+      return true;
+    }
+    case LUA_TTABLE: return writeTable(L, index, encoder);
+    default: break;
+  }
+
+  encoder->badType = lua_type(L, index);
+  return false;
+}
+
+static void luax_checktable(lua_State* L, int index, Variant* variant) {
+  int top = lua_gettop(L);
+  Encoder encoder = { .seen = top + 1 };
+  arr_init(&encoder.bytes);
+  arr_init(&encoder.objects);
+  lua_newtable(L);
+
+  bool success = writeTable(L, index, &encoder);
+  lua_settop(L, top);
+
+  if (!success) {
+    arr_free(&encoder.bytes);
+    arr_free(&encoder.objects);
+    lovrThrow("Bad variant type in table for argument %d: %s", index, lua_typename(L, encoder.badType));
+  }
+
+  size_t objectSize = encoder.objects.length * sizeof(VariantObject);
+  char* data = malloc(objectSize + encoder.bytes.length);
+  lovrAssert(data, "Out of memory");
+  memcpy(data, encoder.objects.data, objectSize);
+  memcpy(data + objectSize, encoder.bytes.data, encoder.bytes.length);
+
+  for (size_t i = 0; i < encoder.objects.length; i++) {
+    lovrRetain(encoder.objects.data[i].pointer);
+  }
+
+  variant->type = TYPE_TABLE;
+  variant->value.table.data = data;
+  variant->value.table.size = objectSize + encoder.bytes.length;
+  variant->value.table.objectCount = (uint32_t) encoder.objects.length;
+  arr_free(&encoder.bytes);
+  arr_free(&encoder.objects);
+}
+
+typedef struct {
+  const char* cursor;
+  VariantObject* objects;
+  uint32_t tableCount;
+  int tables;
+} Decoder;
+
+static uint32_t readU32(Decoder* decoder) {
+  uint32_t x;
+  memcpy(&x, decoder->cursor, sizeof(x));
+  decoder->cursor += sizeof(x);
+  return x;
+}
+
+static double readNumber(Decoder* decoder) {
+  double x;
+  memcpy(&x, decoder->cursor, sizeof(x));
+  decoder->cursor += sizeof(x);
+  return x;
+}
+
+static void readValue(lua_State* L, Decoder* decoder) {
+  switch (*decoder->cursor++) {
+    case TAG_NIL: lua_pushnil(L); break;
+    case TAG_FALSE: lua_pushboolean(L, false); break;
+    case TAG_TRUE: lua_pushboolean(L, true); break;
+    case TAG_NUMBER: lua_pushnumber(L, readNumber(decoder)); break;
+    case TAG_STRING: {
+      uint32_t length = readU32(decoder);
+      lua_pushlstring(L, decoder->cursor, length);
+      decoder->cursor += length;
+      break;
+    }
+    case TAG_OBJECT: {
+      VariantObject* object = &decoder->objects[readU32(decoder)];
+      _luax_pushtype(L, object->type, hash64(object->type, strlen(object->type)), object->pointer);
+      break;
+    }
+    case TAG_REFERENCE: lua_rawgeti(L, decoder->tables, readU32(decoder) + 1); break;
+    case TAG_TABLE: {
+      luaL_checkstack(L, 4, "Table is nested too deeply to be received");
+      uint32_t length = readU32(decoder);
+      bool packed = *decoder->cursor++;
+      lua_createtable(L, length, 0);
+      lua_pushvalue(L, -1);
+      lua_rawseti(L, decoder->tables, ++decoder->tableCount);
+
+      for (uint32_t i = 1; i <= length; i++) {
+        if (packed) {
+          lua_pushnumber(L, readNumber(decoder));
+        } else {
+          readValue(L, decoder);
+        }
+        lua_rawseti(L, -2, i);
+      }
+
+      uint32_t pairCount = readU32(decoder);
+      for (uint32_t i = 0; i < pairCount; i++) {
+        readValue(L, decoder);
+        readValue(L, decoder);
+        lua_rawset(L, -3);
+      }
+      break;
+    }
+  }
+}
+
+static void luax_pushtable(lua_State* L, VariantTable* table) {
+  Decoder decoder;
+  decoder.objects = table->data;
+  decoder.cursor = (char*) table->data + table->objectCount * sizeof(VariantObject);
+  decoder.tableCount = 0;
+  lua_newtable(L);
+  decoder.tables = lua_gettop(L);
+  readValue(L, &decoder);
+  lua_remove(L, decoder.tables);
+}
+
 void luax_checkvariant(lua_State* L, int index, Variant* variant) {
   int type = lua_type(L, index);
   switch (type) {
@@ -38,30 +313,17 @@ void luax_checkvariant(lua_State* L, int index, Variant* variant) {
       variant->type = TYPE_STRING;
       size_t length;
       const char* string = lua_tolstring(L, index, &length);
-      variant->value.string = malloc(length + 1);
-      lovrAssert(variant->value.string, "Out of memory");
-      memcpy(variant->value.string, string, length);
-      variant->value.string[length] = '\0';
+      variant->value.string = lovrVariantStringCreate(string, length);
       break;
 
     case LUA_TUSERDATA:
       variant->type = TYPE_OBJECT;
-      Proxy* proxy = lua_touserdata(L, index);
-      lua_getmetatable(L, index);
-
-      lua_pushliteral(L, "__name");
-      lua_rawget(L, -2);
-      variant->value.object.type = (const char*) lua_touserdata(L, -1);
-      lua_pop(L, 1);
-
-      lua_pushliteral(L, "__destructor");
-      lua_rawget(L, -2);
-      variant->value.object.destructor = (void (*)(void*)) lua_tocfunction(L, -1);
-      lua_pop(L, 1);
-
-      variant->value.object.pointer = proxy->object;
-      lovrRetain(proxy->object);
-      lua_pop(L, 1);
+      lovrAssert(luax_checkobject(L, index, &variant->value.object), "Bad variant type for argument %d: userdata", index);
+      lovrRetain(variant->value.object.pointer);
+      break;
+
+    case LUA_TTABLE:
+      luax_checktable(L, index > 0 || index <= LUA_REGISTRYINDEX ? index : lua_gettop(L) + index + 1, variant);
       break;
 
     default:
@@ -75,8 +337,9 @@ int luax_pushvariant(lua_State* L, Variant* variant) {
     case TYPE_NIL: lua_pushnil(L); return 1;
     case TYPE_BOOLEAN: lua_pushboolean(L, variant->value.boolean); return 1;
     case TYPE_NUMBER: lua_pushnumber(L, variant->value.number); return 1;
-    case TYPE_STRING: lua_pushstring(L, variant->value.string); return 1;
+    case TYPE_STRING: lua_pushlstring(L, variant->value.string->data, variant->value.string->length); return 1;
     case TYPE_OBJECT: _luax_pushtype(L, variant->value.object.type, hash64(variant->value.object.type, strlen(variant->value.object.type)), variant->value.object.pointer); return 1;
+    case TYPE_TABLE: luax_pushtable(L, &variant->value.table); return 1;
     default: return 0;
   }
 }
@@ -112,6 +375,7 @@ static int nextEvent(lua_State* L) {
       luax_pushtype(L, Thread, event.data.thread.thread);
       lua_pushstring(L, event.data.thread.error);
       lovrRelease(Thread, event.data.thread.thread);
+      free(event.data.thread.error);
       return 3;
 #endif
 
@@ -164,8 +428,15 @@ static int l_lovrEventPush(lua_State* L) {
     luax_checkvariant(L, 2 + i, &eventData.data[i]);
   }
 
-  lovrEventPush((Event) { .type = EVENT_CUSTOM, .data.custom = eventData });
-  return 0;
+  bool pushed = lovrEventPush((Event) { .type = EVENT_CUSTOM, .data.custom = eventData });
+  if (!pushed) {
+    for (uint32_t i = 0; i < eventData.count; i++) {
+      lovrVariantDestroy(&eventData.data[i]);
+    }
+  }
+
+  lua_pushboolean(L, pushed);
+  return 1;
 }
 
 static int l_lovrEventQuit(lua_State* L) {
@@ -205,15 +476,38 @@ int luaopen_lovr_event(lua_State* L) {
   lua_pushcfunction(L, nextEvent);
   pollRef = luaL_ref(L, LUA_REGISTRYINDEX);
 
-  if (lovrEventInit()) {
+  uint32_t capacity = 256;
+  bool fixed = false;
+  bool hotkeys = false;
+
+  // Threads don't have a conf table, but the queue is shared so it's already set up by then
+  luax_pushconf(L);
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "hotkeys");
+    hotkeys = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "event");
+    if (lua_istable(L, -1)) {
+      lua_getfield(L, -1, "capacity");
+      lua_Integer n = luaL_optinteger(L, -1, capacity);
+      lovrAssert(n > 0 && n <= MAX_EVENT_CAPACITY, "t.event.capacity must be between 1 and %d", MAX_EVENT_CAPACITY);
+      capacity = (uint32_t) n;
+      lua_getfield(L, -2, "fixed");
+      fixed = lua_toboolean(L, -1);
+      lua_pop(L, 2);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+
+  if (lovrEventInit(capacity, fixed)) {
     luax_atexit(L, lovrEventDestroy);
   }
 
-  luax_pushconf(L);
-  lua_getfield(L, -1, "hotkeys");
-  if (lua_toboolean(L, -1)) {
+  if (hotkeys) {
     lovrPlatformOnKeyboardEvent(hotkeyHandler);
   }
-  lua_pop(L, 2);
+
   return 1;
 }
@@ -11,6 +11,24 @@ void* luax_readfile(const char* filename, size_t* bytesRead) {
   return lovrFilesystemRead(filename, -1, bytesRead);
 }
 
+// Files stored uncompressed in a zip get a Blob that points into the archive instead of a copy.
+// The archive is mapped read only, so these Blobs are only given to objects that read from them,
+// never to Lua (lovr.filesystem.newBlob makes a copy that can be written to).
+static Blob* loadBlob(const char* path) {
+  size_t size;
+  FileMapping* mapping;
+  void* data = lovrFilesystemMap(path, &size, &mapping);
+  if (data) {
+    Blob* blob = lovrBlobCreate(data, size, path);
+    blob->owner = mapping;
+    blob->destructor = lovrFileMappingDestroy;
+    return blob;
+  }
+
+  data = luax_readfile(path, &size);
+  return data ? lovrBlobCreate(data, size, path) : NULL;
+}
+
 // Returns a Blob, leaving stack unchanged.  The Blob must be released when finished.
 Blob* luax_readblob(lua_State* L, int index, const char* debug) {
   if (lua_type(L, index) == LUA_TUSERDATA) {
@@ -19,14 +37,11 @@ Blob* luax_readblob(lua_State* L, int index, const char* debug) {
     return blob;
   } else {
     const char* path = luaL_checkstring(L, index);
-
-    size_t size;
-    void* data = luax_readfile(path, &size);
-    if (!data) {
+    Blob* blob = loadBlob(path);
+    if (!blob) {
       luaL_error(L, "Could not read %s from '%s'", debug, path);
     }
-
-    return lovrBlobCreate(data, size, path);
+    return blob;
   }
 }
 
@@ -107,6 +122,31 @@ static int l_lovrFilesystemGetApplicationId(lua_State *L) {
   return 1;
 }
 
+static int l_lovrFilesystemGetCacheStats(lua_State* L) {
+  if (lua_gettop(L) > 0) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 1);
+  } else {
+    lua_createtable(L, 0, 6);
+  }
+
+  FileCacheStats stats;
+  lovrFilesystemGetCacheStats(&stats);
+  lua_pushnumber(L, stats.hits);
+  lua_setfield(L, 1, "hits");
+  lua_pushnumber(L, stats.misses);
+  lua_setfield(L, 1, "misses");
+  lua_pushnumber(L, stats.bytesSaved);
+  lua_setfield(L, 1, "bytessaved");
+  lua_pushnumber(L, stats.size);
+  lua_setfield(L, 1, "size");
+  lua_pushnumber(L, stats.budget);
+  lua_setfield(L, 1, "budget");
+  lua_pushinteger(L, stats.count);
+  lua_setfield(L, 1, "count");
+  return 1;
+}
+
 static int l_lovrFilesystemGetDirectoryItems(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   lua_settop(L, 1);
@@ -264,9 +304,9 @@ static int l_lovrFilesystemMount(lua_State* L) {
 }
 
 static int l_lovrFilesystemNewBlob(lua_State* L) {
-  size_t size;
   const char* path = luaL_checkstring(L, 1);
-  uint8_t* data = luax_readfile(path, &size);
+  size_t size;
+  void* data = luax_readfile(path, &size);
   lovrAssert(data, "Could not load file '%s'", path);
   Blob* blob = lovrBlobCreate(data, size, path);
   luax_pushtype(L, Blob, blob);
@@ -274,6 +314,37 @@ static int l_lovrFilesystemNewBlob(lua_State* L) {
   return 1;
 }
 
+// Takes a table of paths, or paths as separate arguments
+static int l_lovrFilesystemPrefetch(lua_State* L) {
+  bool table = lua_istable(L, 1);
+  uint32_t count = table ? luax_len(L, 1) : lua_gettop(L);
+  const char** paths = malloc(count * sizeof(const char*));
+  lovrAssert(paths || count == 0, "Out of memory");
+
+  // The strings stay referenced by the table (or the stack) until the paths are freed
+  for (uint32_t i = 0; i < count; i++) {
+    if (table) {
+      lua_rawgeti(L, 1, i + 1);
+      paths[i] = lua_type(L, -1) == LUA_TSTRING ? lua_tostring(L, -1) : NULL;
+      lua_pop(L, 1);
+      if (!paths[i]) {
+        free(paths);
+        return luaL_error(L, "Expected a string for path #%d", i + 1);
+      }
+    } else {
+      paths[i] = lua_tostring(L, i + 1);
+      if (!paths[i]) {
+        free(paths);
+        return luaL_argerror(L, i + 1, "expected string");
+      }
+    }
+  }
+
+  lua_pushinteger(L, lovrFilesystemPrefetch(paths, count));
+  free(paths);
+  return 1;
+}
+
 static int l_lovrFilesystemRead(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   lua_Integer luaSize = luaL_optinteger(L, 2, -1);
@@ -296,6 +367,12 @@ static int l_lovrFilesystemRemove(lua_State* L) {
   return 1;
 }
 
+static int l_lovrFilesystemSetCacheBudget(lua_State* L) {
+  lua_Number budget = luaL_checknumber(L, 1);
+  lovrFilesystemSetCacheBudget(MAX(budget, 0));
+  return 0;
+}
+
 static int l_lovrFilesystemSetIdentity(lua_State* L) {
   const char* identity = luaL_checkstring(L, 1);
   lovrFilesystemSetIdentity(identity);
@@ -327,6 +404,7 @@ static const luaL_Reg lovrFilesystem[] = {
   { "createDirectory", l_lovrFilesystemCreateDirectory },
   { "getAppdataDirectory", l_lovrFilesystemGetAppdataDirectory },
   { "getApplicationId", l_lovrFilesystemGetApplicationId },
+  { "getCacheStats", l_lovrFilesystemGetCacheStats },
   { "getDirectoryItems", l_lovrFilesystemGetDirectoryItems },
   { "getExecutablePath", l_lovrFilesystemGetExecutablePath },
   { "getIdentity", l_lovrFilesystemGetIdentity },
@@ -344,8 +422,10 @@ static const luaL_Reg lovrFilesystem[] = {
   { "load", l_lovrFilesystemLoad },
   { "mount", l_lovrFilesystemMount },
   { "newBlob", l_lovrFilesystemNewBlob },
+  { "prefetch", l_lovrFilesystemPrefetch },
   { "read", l_lovrFilesystemRead },
   { "remove", l_lovrFilesystemRemove },
+  { "setCacheBudget", l_lovrFilesystemSetCacheBudget },
   { "setRequirePath", l_lovrFilesystemSetRequirePath },
   { "setIdentity", l_lovrFilesystemSetIdentity },
   { "unmount", l_lovrFilesystemUnmount },
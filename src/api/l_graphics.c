@@ -34,6 +34,18 @@ const char* AttributeTypes[] = {
   NULL
 };
 
+const char* BatchMisses[] = {
+  [MISS_TYPE] = "type",
+  [MISS_FULL] = "full",
+  [MISS_MESH] = "mesh",
+  [MISS_CANVAS] = "canvas",
+  [MISS_SHADER] = "shader",
+  [MISS_MATERIAL] = "material",
+  [MISS_PIPELINE] = "pipeline",
+  [MISS_PARAMS] = "params",
+  NULL
+};
+
 const char* BlendAlphaModes[] = {
   [BLEND_ALPHA_MULTIPLY] = "alphamultiply",
   [BLEND_PREMULTIPLIED] = "premultiplied",
@@ -115,6 +127,18 @@ const char* FilterModes[] = {
   NULL
 };
 
+const char* FlushReasons[] = {
+  [FLUSH_OTHER] = "other",
+  [FLUSH_STREAM] = "stream",
+  [FLUSH_BATCHES] = "batches",
+  [FLUSH_CANVAS] = "canvas",
+  [FLUSH_SHADER] = "shader",
+  [FLUSH_MATERIAL] = "material",
+  [FLUSH_MESH] = "mesh",
+  [FLUSH_CAMERA] = "camera",
+  NULL
+};
+
 const char* HorizontalAligns[] = {
   [ALIGN_LEFT] = "left",
   [ALIGN_CENTER] = "center",
@@ -160,6 +184,17 @@ const char* StencilActions[] = {
   NULL
 };
 
+const char* StreamTypes[] = {
+  [STREAM_VERTEX] = "vertex",
+  [STREAM_DRAWID] = "drawid",
+  [STREAM_INDEX] = "index",
+  [STREAM_MODEL] = "model",
+  [STREAM_COLOR] = "color",
+  [STREAM_FRAME] = "frame",
+  [STREAM_POSE] = "pose",
+  NULL
+};
+
 const char* TextureFormats[] = {
   [FORMAT_RGB] = "rgb",
   [FORMAT_RGBA] = "rgba",
@@ -315,8 +350,16 @@ static TextureData* luax_checktexturedata(lua_State* L, int index, bool flip) {
 
 // Base
 
+#ifdef LOVR_ENABLE_THREAD
+// Seconds per frame that can be spent finalizing async loads (uploading them to the GPU)
+static double uploadBudget = .002;
+#endif
+
 static int l_lovrGraphicsPresent(lua_State* L) {
   lovrGraphicsPresent();
+#ifdef LOVR_ENABLE_THREAD
+  luax_finalizejobs(L, uploadBudget);
+#endif
   return 0;
 }
 
@@ -454,7 +497,7 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
     luaL_checktype(L, 1, LUA_TTABLE);
     lua_settop(L, 1);
   } else {
-    lua_createtable(L, 0, 2);
+    lua_createtable(L, 0, 10);
   }
 
   lovrGraphicsFlush();
@@ -463,6 +506,37 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
   lua_setfield(L, 1, "drawcalls");
   lua_pushinteger(L, stats->shaderSwitches);
   lua_setfield(L, 1, "shaderswitches");
+  lua_pushinteger(L, stats->fenceWaits);
+  lua_setfield(L, 1, "fencewaits");
+  lua_pushinteger(L, stats->culledDraws);
+  lua_setfield(L, 1, "culleddraws");
+  lua_pushinteger(L, stats->visibleDraws);
+  lua_setfield(L, 1, "visibledraws");
+  lua_pushinteger(L, stats->textureBinds);
+  lua_setfield(L, 1, "texturebinds");
+  lua_pushinteger(L, stats->pipelineChanges);
+  lua_setfield(L, 1, "pipelinechanges");
+
+  lua_createtable(L, 0, MAX_FLUSH_REASONS);
+  for (int i = 0; i < MAX_FLUSH_REASONS; i++) {
+    lua_pushinteger(L, stats->flushes[i]);
+    lua_setfield(L, -2, FlushReasons[i]);
+  }
+  lua_setfield(L, 1, "flushes");
+
+  lua_createtable(L, 0, MAX_BATCH_MISSES);
+  for (int i = 0; i < MAX_BATCH_MISSES; i++) {
+    lua_pushinteger(L, stats->batchMisses[i]);
+    lua_setfield(L, -2, BatchMisses[i]);
+  }
+  lua_setfield(L, 1, "batchmisses");
+
+  lua_createtable(L, 0, MAX_STREAMS);
+  for (int i = 0; i < MAX_STREAMS; i++) {
+    lua_pushnumber(L, (lua_Number) stats->streamBytes[i]);
+    lua_setfield(L, -2, StreamTypes[i]);
+  }
+  lua_setfield(L, 1, "streambytes");
   return 1;
 }
 
@@ -589,6 +663,16 @@ static int l_lovrGraphicsSetDefaultFilter(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsIsDeferred(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsDeferred());
+  return 1;
+}
+
+static int l_lovrGraphicsSetDeferred(lua_State* L) {
+  lovrGraphicsSetDeferred(lua_toboolean(L, 1));
+  return 0;
+}
+
 static int l_lovrGraphicsGetDepthTest(lua_State* L) {
   CompareMode mode;
   bool write;
@@ -605,6 +689,16 @@ static int l_lovrGraphicsSetDepthTest(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsIsFrustumCullingEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsFrustumCullingEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetFrustumCullingEnabled(lua_State* L) {
+  lovrGraphicsSetFrustumCullingEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
 static int l_lovrGraphicsGetFont(lua_State* L) {
   Font* font = lovrGraphicsGetFont();
   luax_pushtype(L, Font, font);
@@ -1393,13 +1487,31 @@ static int l_lovrGraphicsNewModel(lua_State* L) {
     lovrRetain(modelData);
   }
 
-  Model* model = lovrModelCreate(modelData);
+  bool staticBatching = false;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "static");
+    staticBatching = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  Model* model = lovrModelCreate(modelData, staticBatching);
   luax_pushtype(L, Model, model);
   lovrRelease(ModelData, modelData);
   lovrRelease(Model, model);
   return 1;
 }
 
+#ifdef LOVR_ENABLE_THREAD
+// The ModelData is decoded on a worker, the Model is created on the main thread once it's ready
+static int l_lovrGraphicsNewModelAsync(lua_State* L) {
+  lua_settop(L, 2);
+  return luax_submitjob(L,
+    "local source, options = ...\n"
+    "return require('lovr.data').newModelData(source), options",
+    1, l_lovrGraphicsNewModel);
+}
+#endif
+
 static const char* luax_checkshadersource(lua_State* L, int index) {
   if (lua_isnoneornil(L, index)) {
     return NULL;
@@ -1647,8 +1759,12 @@ static const luaL_Reg lovrGraphics[] = {
   { "setCullingEnabled", l_lovrGraphicsSetCullingEnabled },
   { "getDefaultFilter", l_lovrGraphicsGetDefaultFilter },
   { "setDefaultFilter", l_lovrGraphicsSetDefaultFilter },
+  { "isDeferred", l_lovrGraphicsIsDeferred },
+  { "setDeferred", l_lovrGraphicsSetDeferred },
   { "getDepthTest", l_lovrGraphicsGetDepthTest },
   { "setDepthTest", l_lovrGraphicsSetDepthTest },
+  { "isFrustumCullingEnabled", l_lovrGraphicsIsFrustumCullingEnabled },
+  { "setFrustumCullingEnabled", l_lovrGraphicsSetFrustumCullingEnabled },
   { "getFont", l_lovrGraphicsGetFont },
   { "setFont", l_lovrGraphicsSetFont },
   { "getLineWidth", l_lovrGraphicsGetLineWidth },
@@ -1700,6 +1816,9 @@ static const luaL_Reg lovrGraphics[] = {
   { "newMaterial", l_lovrGraphicsNewMaterial },
   { "newMesh", l_lovrGraphicsNewMesh },
   { "newModel", l_lovrGraphicsNewModel },
+#ifdef LOVR_ENABLE_THREAD
+  { "newModelAsync", l_lovrGraphicsNewModelAsync },
+#endif
   { "newShader", l_lovrGraphicsNewShader },
   { "newComputeShader", l_lovrGraphicsNewComputeShader },
   { "newShaderBlock", l_lovrGraphicsNewShaderBlock },
@@ -1708,6 +1827,14 @@ static const luaL_Reg lovrGraphics[] = {
   { NULL, NULL }
 };
 
+static uint32_t luax_checkstreamsize(lua_State* L, int index, const char* name, uint32_t fallback) {
+  lua_Number count = luaL_optnumber(L, index, fallback);
+  if (!(count >= 1 && count <= MAX_STREAM_ELEMENTS)) {
+    luaL_error(L, "Bad value for t.graphics.streams.%s (expected 1 to %d, got %f)", name, MAX_STREAM_ELEMENTS, count);
+  }
+  return (uint32_t) count;
+}
+
 int luaopen_lovr_graphics(lua_State* L) {
   lua_newtable(L);
   luaL_register(L, NULL, lovrGraphics);
@@ -1719,7 +1846,34 @@ int luaopen_lovr_graphics(lua_State* L) {
   luax_registertype(L, Shader);
   luax_registertype(L, ShaderBlock);
   luax_registertype(L, Texture);
-  lovrGraphicsInit();
+
+  uint32_t vertexCount = 1 << 16;
+  uint32_t indexCount = 1 << 16;
+
+  luax_pushconf(L);
+  lua_getfield(L, -1, "graphics");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "streams");
+    if (lua_istable(L, -1)) {
+      lua_getfield(L, -1, "vertices");
+      vertexCount = luax_checkstreamsize(L, -1, "vertices", vertexCount);
+      lua_pop(L, 1);
+
+      lua_getfield(L, -1, "indices");
+      indexCount = luax_checkstreamsize(L, -1, "indices", indexCount);
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+#ifdef LOVR_ENABLE_THREAD
+    lua_getfield(L, -1, "uploadbudget");
+    uploadBudget = luaL_optnumber(L, -1, uploadBudget);
+    lua_pop(L, 1);
+#endif
+  }
+  lua_pop(L, 2);
+
+  lovrGraphicsInit(vertexCount, indexCount);
 
   luax_pushconf(L);
   lua_pushcfunction(L, l_lovrGraphicsCreateWindow);
@@ -424,7 +424,7 @@ int l_lovrHeadsetNewModel(lua_State* L) {
   }
 
   if (modelData) {
-    Model* model = lovrModelCreate(modelData);
+    Model* model = lovrModelCreate(modelData, false);
     luax_pushtype(L, Model, model);
     lovrRelease(ModelData, modelData);
     lovrRelease(Model, model);
@@ -2,18 +2,15 @@
 #include "event/event.h"
 #include "thread/thread.h"
 #include "thread/channel.h"
+#include "thread/job.h"
+#include "core/arr.h"
+#include "core/os.h"
 #include "core/ref.h"
+#include "core/util.h"
 #include <stdlib.h>
 #include <string.h>
 
-static int threadRunner(void* data) {
-  Thread* thread = (Thread*) data;
-
-  lovrRetain(thread);
-  mtx_lock(&thread->lock);
-  thread->running = true;
-  mtx_unlock(&thread->lock);
-
+static lua_State* newThreadState(void) {
   lua_State* L = luaL_newstate();
   luaL_openlibs(L);
   lovrSetErrorCallback((errorFn*) luax_vthrow, L);
@@ -22,8 +19,155 @@ static int threadRunner(void* data) {
   lua_getfield(L, -1, "preload");
   luaL_register(L, NULL, lovrModules);
   lua_pop(L, 2);
+  return L;
+}
+
+// Threads that run on the pool use their host's Lua state, which stays alive between Threads.  The
+// host keeps the chunks it has compiled, keyed by the body Blob, which it retains so the key can't
+// be reused by a different Blob.  After each run the globals and package.loaded are put back the
+// way they were when the host started, so globals and modules from one Thread don't leak into the
+// next.  The lovr modules stay loaded: their tables are shared by every Thread on the host, so
+// fields set on them stick, and so do changes made to the tables of the standard libraries.
+
+#define MAX_POOLED_BODIES 16
+
+static LOVR_THREAD_LOCAL lua_State* hostState;
+static LOVR_THREAD_LOCAL arr_t(Blob*) hostBodies;
+
+static void snapshotTable(lua_State* L, int index) {
+  lua_newtable(L);
+  lua_pushnil(L);
+  while (lua_next(L, index)) {
+    lua_pushvalue(L, -2);
+    lua_insert(L, -2);
+    lua_rawset(L, -4);
+  }
+}
+
+static void clearPooledBodies(void) {
+  for (size_t i = 0; i < hostBodies.length; i++) {
+    lovrRelease(Blob, hostBodies.data[i]);
+  }
+  arr_clear(&hostBodies);
+  lua_newtable(hostState);
+  lua_setfield(hostState, LUA_REGISTRYINDEX, "_lovrthreadcode");
+}
+
+static void startHost(void) {
+  hostState = newThreadState();
+  arr_init(&hostBodies);
+  clearPooledBodies();
+  snapshotTable(hostState, LUA_GLOBALSINDEX);
+  lua_setfield(hostState, LUA_REGISTRYINDEX, "_lovrthreadglobals");
+  lua_getglobal(hostState, "package");
+  lua_getfield(hostState, -1, "loaded");
+  snapshotTable(hostState, lua_gettop(hostState));
+  lua_setfield(hostState, LUA_REGISTRYINDEX, "_lovrthreadloaded");
+  lua_pop(hostState, 2);
+}
+
+static void stopHost(void) {
+  lua_close(hostState);
+  hostState = NULL;
+  for (size_t i = 0; i < hostBodies.length; i++) {
+    lovrRelease(Blob, hostBodies.data[i]);
+  }
+  arr_free(&hostBodies);
+}
+
+static int loadPooledBody(lua_State* L, Blob* body) {
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrthreadcode");
+  lua_pushlightuserdata(L, body);
+  lua_rawget(L, -2);
+  if (!lua_isnil(L, -1)) {
+    lua_remove(L, -2);
+    return 0;
+  }
+
+  lua_pop(L, 2);
+  int status = luaL_loadbuffer(L, body->data, body->size, "thread");
+  if (status) {
+    return status;
+  }
+
+  if (hostBodies.length >= MAX_POOLED_BODIES) {
+    clearPooledBodies();
+  }
+
+  lovrRetain(body);
+  arr_push(&hostBodies, body);
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrthreadcode");
+  lua_pushlightuserdata(L, body);
+  lua_pushvalue(L, -3);
+  lua_rawset(L, -3);
+  lua_pop(L, 1);
+  return 0;
+}
+
+static bool isLovrModule(lua_State* L, int index) {
+  if (lua_type(L, index) != LUA_TSTRING) {
+    return false;
+  }
+
+  const char* name = lua_tostring(L, index);
+  return !strcmp(name, "lovr") || !strncmp(name, "lovr.", 5);
+}
+
+// Removes the keys of the table at the top of the stack that aren't in the snapshot (except the lovr
+// modules, when restoring package.loaded), then copies the snapshot back over it
+static void restoreTable(lua_State* L, const char* snapshot, bool modules) {
+  int table = lua_gettop(L);
+  lua_getfield(L, LUA_REGISTRYINDEX, snapshot);
+  lua_pushnil(L);
+  while (lua_next(L, table)) {
+    lua_pop(L, 1);
+    lua_pushvalue(L, -1);
+    lua_rawget(L, table + 1);
+    bool keep = !lua_isnil(L, -1) || (modules && isLovrModule(L, -2));
+    lua_pop(L, 1);
+    if (!keep) {
+      lua_pushvalue(L, -1);
+      lua_pushnil(L);
+      lua_rawset(L, table);
+    }
+  }
+
+  lua_pushnil(L);
+  while (lua_next(L, table + 1)) {
+    lua_pushvalue(L, -2);
+    lua_insert(L, -2);
+    lua_rawset(L, table);
+  }
+  lua_settop(L, table);
+}
+
+static void resetPooledState(lua_State* L, int top) {
+  lua_settop(L, top);
+  lua_pushvalue(L, LUA_GLOBALSINDEX);
+  lua_pushnil(L);
+  lua_setmetatable(L, -2);
+  restoreTable(L, "_lovrthreadglobals", false);
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "loaded");
+  restoreTable(L, "_lovrthreadloaded", true);
+  lua_settop(L, top);
+}
 
-  if (!luaL_loadbuffer(L, thread->body->data, thread->body->size, "thread")) {
+static int threadRunner(void* data) {
+  Thread* thread = (Thread*) data;
+
+  lovrRetain(thread);
+  mtx_lock(&thread->lock);
+  thread->running = true;
+  mtx_unlock(&thread->lock);
+
+  lua_State* L = hostState ? hostState : newThreadState();
+  int top = lua_gettop(L);
+  int status = hostState ?
+    loadPooledBody(L, thread->body) :
+    luaL_loadbuffer(L, thread->body->data, thread->body->size, "thread");
+
+  if (!status) {
     for (size_t i = 0; i < thread->argumentCount; i++) {
       luax_pushvariant(L, &thread->arguments[i]);
     }
@@ -33,7 +177,11 @@ static int threadRunner(void* data) {
       thread->running = false;
       mtx_unlock(&thread->lock);
       lovrRelease(Thread, thread);
-      lua_close(L);
+      if (L == hostState) {
+        resetPooledState(L, top);
+      } else {
+        lua_close(L);
+      }
       return 0;
     }
   }
@@ -53,10 +201,364 @@ static int threadRunner(void* data) {
   thread->running = false;
   mtx_unlock(&thread->lock);
   lovrRelease(Thread, thread);
-  lua_close(L);
+  if (L == hostState) {
+    resetPooledState(L, top);
+  } else {
+    lua_close(L);
+  }
+  return 1;
+}
+
+// Lua jobs run on a Lua state owned by each worker thread.  Functions are sent as bytecode, so they
+// can't have upvalues.  Each worker state caches the functions it has loaded, keyed by bytecode.
+
+typedef struct {
+  VariantString* code;
+  Variant* arguments;
+  uint32_t argumentCount;
+  Variant* results;
+  uint32_t resultCount;
+  char* error;
+  lua_CFunction finalize;
+  bool finalized;
+} LuaJob;
+
+typedef struct {
+  VariantString* code;
+  Variant* arguments;
+  uint32_t argumentCount;
+  mtx_t lock;
+  char* error;
+} LuaRange;
+
+static LOVR_THREAD_LOCAL lua_State* workerState;
+
+// Jobs with a finalizer, in submission order (only touched on the main thread)
+static arr_t(Job*) pendingJobs;
+
+static void startWorker(uint32_t worker) {
+  workerState = newThreadState();
+  lua_newtable(workerState);
+  lua_setfield(workerState, LUA_REGISTRYINDEX, "_lovrjobs");
+}
+
+static void stopWorker(uint32_t worker) {
+  lua_close(workerState);
+  workerState = NULL;
+}
+
+static int writeBytecode(lua_State* L, const void* data, size_t size, void* userdata) {
+  luaL_addlstring((luaL_Buffer*) userdata, data, size);
+  return 0;
+}
+
+// Strings are used as code, functions are dumped to bytecode (cached per function)
+static VariantString* luax_checkjobcode(lua_State* L, int index) {
+  size_t length;
+  const char* code;
+
+  if (lua_type(L, index) == LUA_TSTRING) {
+    code = lua_tolstring(L, index, &length);
+    return lovrVariantStringCreate(code, length);
+  }
+
+  luaL_checktype(L, index, LUA_TFUNCTION);
+  lovrAssert(!lua_iscfunction(L, index), "C functions can not be run as jobs");
+  lovrAssert(!lua_getupvalue(L, index, 1), "Functions run as jobs can not have upvalues");
+
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrjobcode");
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, "_lovrjobcode");
+  }
+
+  lua_pushvalue(L, index);
+  lua_rawget(L, -2);
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    luaL_Buffer buffer;
+    lua_pushvalue(L, index);
+    luaL_buffinit(L, &buffer);
+    lua_dump(L, writeBytecode, &buffer);
+    luaL_pushresult(&buffer);
+    lua_remove(L, -2);
+    lua_pushvalue(L, index);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+  }
+
+  code = lua_tolstring(L, -1, &length);
+  VariantString* string = lovrVariantStringCreate(code, length);
+  lua_pop(L, 2);
+  return string;
+}
+
+static Variant* luax_checkjobarguments(lua_State* L, int index, uint32_t* count) {
+  *count = MAX(lua_gettop(L) - index + 1, 0);
+  Variant* arguments = malloc(*count * sizeof(Variant));
+  lovrAssert(arguments || *count == 0, "Out of memory");
+  for (uint32_t i = 0; i < *count; i++) {
+    luax_checkvariant(L, index + i, &arguments[i]);
+  }
+  return arguments;
+}
+
+static void destroyJobArguments(VariantString* code, Variant* arguments, uint32_t count) {
+  free(code);
+  for (uint32_t i = 0; i < count; i++) {
+    lovrVariantDestroy(&arguments[i]);
+  }
+  free(arguments);
+}
+
+static void luax_loadjobcode(lua_State* L, VariantString* code) {
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrjobs");
+  lua_pushlstring(L, code->data, code->length);
+  lua_pushvalue(L, -1);
+  lua_rawget(L, -3);
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    if (luaL_loadbuffer(L, code->data, code->length, "job")) {
+      lua_error(L);
+    }
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -5);
+  }
+  lua_replace(L, -3);
+  lua_pop(L, 1);
+}
+
+static char* copyError(lua_State* L) {
+  size_t length;
+  const char* message = lua_tolstring(L, -1, &length);
+  if (!message) {
+    message = "Unknown error";
+    length = strlen(message);
+  }
+  char* error = malloc(length + 1);
+  if (error) memcpy(error, message, length + 1);
+  return error;
+}
+
+static int runJob(lua_State* L) {
+  LuaJob* job = lua_touserdata(L, 1);
+  int base = lua_gettop(L);
+  luax_loadjobcode(L, job->code);
+  for (uint32_t i = 0; i < job->argumentCount; i++) {
+    luax_pushvariant(L, &job->arguments[i]);
+  }
+  lua_call(L, job->argumentCount, LUA_MULTRET);
+
+  uint32_t count = lua_gettop(L) - base;
+  job->results = malloc(count * sizeof(Variant));
+  lovrAssert(job->results || count == 0, "Out of memory");
+  for (uint32_t i = 0; i < count; i++) {
+    luax_checkvariant(L, base + 1 + i, &job->results[i]);
+    job->resultCount++;
+  }
+  return 0;
+}
+
+static void luaJobRunner(void* context) {
+  LuaJob* job = context;
+  lua_State* L = workerState;
+  int top = lua_gettop(L);
+  if (lua_cpcall(L, runJob, job)) {
+    job->error = copyError(L);
+  }
+  lua_settop(L, top);
+}
+
+static void destroyLuaJob(void* context) {
+  LuaJob* job = context;
+  destroyJobArguments(job->code, job->arguments, job->argumentCount);
+  for (uint32_t i = 0; i < job->resultCount; i++) {
+    lovrVariantDestroy(&job->results[i]);
+  }
+  free(job->results);
+  free(job->error);
+  free(job);
+}
+
+static Job* submitLuaJob(lua_State* L, VariantString* code, int index, lua_CFunction finalize) {
+  LuaJob* luaJob = calloc(1, sizeof(LuaJob));
+  lovrAssert(luaJob, "Out of memory");
+  luaJob->code = code;
+  luaJob->arguments = luax_checkjobarguments(L, index, &luaJob->argumentCount);
+  luaJob->finalize = finalize;
+  Job* job = lovrJobSubmit(luaJobRunner, luaJob, destroyLuaJob);
+
+  if (finalize) {
+    lovrRetain(job);
+    arr_push(&pendingJobs, job);
+  }
+
+  return job;
+}
+
+// Runs a chunk of code on a worker, with the arguments from index to the top of the stack.  If there
+// is a finalizer, it gets called on the main thread with the results once the job finishes (during
+// luax_finalizejobs, or when the job is awaited), and its return values become the new results.
+// This is used for work that has to happen on the main thread, like uploading to the GPU.  Pushes
+// the Job, registering its type first if lovr.thread hasn't been required by this Lua state.
+int luax_submitjob(lua_State* L, const char* code, int index, lua_CFunction finalize) {
+  Job* job = submitLuaJob(L, lovrVariantStringCreate(code, strlen(code)), index, finalize);
+
+  luaL_getmetatable(L, "Job");
+  if (lua_isnil(L, -1)) {
+    luax_registertype(L, Job);
+  }
+  lua_pop(L, 1);
+
+  luax_pushtype(L, Job, job);
+  lovrRelease(Job, job);
   return 1;
 }
 
+static int finalizeJob(lua_State* L) {
+  LuaJob* job = lua_touserdata(L, 1);
+  int base = lua_gettop(L);
+  lua_pushcfunction(L, job->finalize);
+  luaL_checkstack(L, job->resultCount, "Too many job results");
+  for (uint32_t i = 0; i < job->resultCount; i++) {
+    luax_pushvariant(L, &job->results[i]);
+  }
+  lua_call(L, job->resultCount, LUA_MULTRET);
+
+  for (uint32_t i = 0; i < job->resultCount; i++) {
+    lovrVariantDestroy(&job->results[i]);
+  }
+  free(job->results);
+  job->results = NULL;
+  job->resultCount = 0;
+
+  uint32_t count = lua_gettop(L) - base;
+  job->results = malloc(count * sizeof(Variant));
+  lovrAssert(job->results || count == 0, "Out of memory");
+  for (uint32_t i = 0; i < count; i++) {
+    luax_checkvariant(L, base + 1 + i, &job->results[i]);
+    job->resultCount++;
+  }
+  return 0;
+}
+
+static void luax_finalizejob(lua_State* L, LuaJob* job) {
+  if (job->finalize && !job->finalized && !job->error) {
+    int top = lua_gettop(L);
+    if (lua_cpcall(L, finalizeJob, job)) {
+      job->error = copyError(L);
+    }
+    lua_settop(L, top);
+  }
+  job->finalized = true;
+}
+
+// Finalizes finished jobs until the time budget (in seconds) runs out.  At least one job gets
+// finalized per call, so progress is made even when a single finalizer is over budget.
+void luax_finalizejobs(lua_State* L, double budget) {
+  double start = lovrPlatformGetTime();
+  uint32_t finalized = 0;
+  size_t i = 0;
+
+  // Finished jobs are spliced out, so the index can't be used to tell whether one has run yet
+  while (i < pendingJobs.length) {
+    Job* job = pendingJobs.data[i];
+    LuaJob* luaJob = lovrJobGetContext(job);
+
+    if (!luaJob->finalized) {
+      if (!lovrJobIsDone(job)) {
+        i++;
+        continue;
+      } else if (finalized > 0 && lovrPlatformGetTime() - start > budget) {
+        break;
+      }
+
+      luax_finalizejob(L, luaJob);
+      finalized++;
+    }
+
+    lovrRelease(Job, job);
+    arr_splice(&pendingJobs, i, 1);
+  }
+}
+
+bool luax_isjobready(Job* job) {
+  LuaJob* luaJob = lovrJobGetContext(job);
+  return lovrJobIsDone(job) && (!luaJob->finalize || luaJob->finalized);
+}
+
+// Waits for a Lua job (finalizing it if needed) and pushes its results, or raises its error
+int luax_awaitjob(lua_State* L, Job* job) {
+  LuaJob* luaJob = lovrJobGetContext(job);
+  lovrJobWait(job);
+  luax_finalizejob(L, luaJob);
+
+  if (luaJob->error) {
+    return luaL_error(L, "%s", luaJob->error);
+  }
+
+  luaL_checkstack(L, luaJob->resultCount, "Too many job results");
+  for (uint32_t i = 0; i < luaJob->resultCount; i++) {
+    luax_pushvariant(L, &luaJob->results[i]);
+  }
+  return luaJob->resultCount;
+}
+
+// Arguments and the function are pushed once per range, then the function is called for each index
+static int runRange(lua_State* L) {
+  LuaRange* range = lua_touserdata(L, 1);
+  uint32_t start = (uint32_t) lua_tonumber(L, 2);
+  uint32_t end = (uint32_t) lua_tonumber(L, 3);
+  luax_loadjobcode(L, range->code);
+  int function = lua_gettop(L);
+  for (uint32_t i = 0; i < range->argumentCount; i++) {
+    luax_pushvariant(L, &range->arguments[i]);
+  }
+
+  for (uint32_t i = start; i < end; i++) {
+    lua_pushvalue(L, function);
+    lua_pushinteger(L, i + 1);
+    for (uint32_t j = 0; j < range->argumentCount; j++) {
+      lua_pushvalue(L, function + 1 + j);
+    }
+    lua_call(L, range->argumentCount + 1, 0);
+  }
+  return 0;
+}
+
+static void luaRangeRunner(void* context, uint32_t start, uint32_t end) {
+  LuaRange* range = context;
+  lua_State* L = workerState;
+
+  mtx_lock(&range->lock);
+  bool failed = range->error;
+  mtx_unlock(&range->lock);
+  if (failed) {
+    return;
+  }
+
+  int top = lua_gettop(L);
+  lua_pushcfunction(L, runRange);
+  lua_pushlightuserdata(L, range);
+  lua_pushnumber(L, start);
+  lua_pushnumber(L, end);
+  if (lua_pcall(L, 3, 0, 0)) {
+    mtx_lock(&range->lock);
+    if (!range->error) {
+      range->error = copyError(L);
+    }
+    mtx_unlock(&range->lock);
+  }
+  lua_settop(L, top);
+}
+
 static int l_lovrThreadNewThread(lua_State* L) {
   Blob* blob = luax_totype(L, 1, Blob);
   if (!blob) {
@@ -84,15 +586,89 @@ static int l_lovrThreadNewThread(lua_State* L) {
 
 static int l_lovrThreadGetChannel(lua_State* L) {
   const char* name = luaL_checkstring(L, 1);
-  Channel* channel = lovrThreadGetChannel(name);
+  uint32_t capacity = 0;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "capacity");
+    capacity = lua_isnil(L, -1) ? 0 : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+  }
+  Channel* channel = lovrThreadGetChannel(name, capacity);
   luax_pushtype(L, Channel, channel);
   lovrRelease(Channel, channel);
   return 1;
 }
 
+static int l_lovrThreadSelect(lua_State* L) {
+  Variant variant;
+  double timeout;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  luax_checktimeout(L, 2, &timeout);
+  uint32_t count = luax_len(L, 1);
+  Channel** channels = malloc(count * sizeof(Channel*));
+  lovrAssert(channels || count == 0, "Out of memory");
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    channels[i] = luax_totype(L, -1, Channel);
+    lua_pop(L, 1);
+    if (!channels[i]) {
+      free(channels);
+      return luaL_error(L, "Expected a list of Channels");
+    }
+  }
+
+  int index = lovrChannelSelect(channels, count, &variant, timeout);
+  free(channels);
+
+  if (index < 0) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_rawgeti(L, 1, index + 1);
+  luax_pushvariant(L, &variant);
+  lovrVariantDestroy(&variant);
+  return 2;
+}
+
+static int l_lovrThreadSubmit(lua_State* L) {
+  VariantString* code = luax_checkjobcode(L, 1);
+  Job* job = submitLuaJob(L, code, 2, NULL);
+  luax_pushtype(L, Job, job);
+  lovrRelease(Job, job);
+  return 1;
+}
+
+static int l_lovrThreadParallel(lua_State* L) {
+  LuaRange range;
+  uint32_t count = luaL_checkinteger(L, 2);
+  uint32_t grain = luaL_optinteger(L, 3, 1);
+  range.code = luax_checkjobcode(L, 1);
+  range.arguments = luax_checkjobarguments(L, 4, &range.argumentCount);
+  range.error = NULL;
+  mtx_init(&range.lock, mtx_plain);
+  lovrJobParallelFor(count, grain, luaRangeRunner, &range);
+  mtx_destroy(&range.lock);
+  destroyJobArguments(range.code, range.arguments, range.argumentCount);
+  if (range.error) {
+    lua_pushstring(L, range.error);
+    free(range.error);
+    return lua_error(L);
+  }
+  return 0;
+}
+
+static int l_lovrThreadGetWorkerCount(lua_State* L) {
+  lua_pushinteger(L, lovrJobGetWorkerCount());
+  return 1;
+}
+
 static const luaL_Reg lovrThreadModule[] = {
   { "newThread", l_lovrThreadNewThread },
   { "getChannel", l_lovrThreadGetChannel },
+  { "select", l_lovrThreadSelect },
+  { "submit", l_lovrThreadSubmit },
+  { "parallel", l_lovrThreadParallel },
+  { "getWorkerCount", l_lovrThreadGetWorkerCount },
   { NULL, NULL }
 };
 
@@ -101,8 +677,37 @@ int luaopen_lovr_thread(lua_State* L) {
   luaL_register(L, NULL, lovrThreadModule);
   luax_registertype(L, Thread);
   luax_registertype(L, Channel);
-  if (lovrThreadModuleInit()) {
+  luax_registertype(L, Job);
+
+  // A negative worker count leaves that many processors free, counting the main thread
+  int32_t workerCount = -1;
+  uint32_t poolSize = 2;
+
+  luax_pushconf(L);
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "thread");
+    if (lua_istable(L, -1)) {
+      lua_getfield(L, -1, "workers");
+      workerCount = luaL_optinteger(L, -1, workerCount);
+      lua_getfield(L, -2, "pool");
+      poolSize = luaL_optinteger(L, -1, poolSize);
+      lua_pop(L, 2);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+
+  if (workerCount < 0) {
+    workerCount = MAX((int32_t) lovrPlatformGetProcessorCount() + workerCount, 1);
+  }
+
+  if (lovrThreadModuleInit(poolSize, startHost, stopHost)) {
     luax_atexit(L, lovrThreadModuleDestroy);
   }
+
+  if (lovrJobSystemInit(workerCount, startWorker, stopWorker)) {
+    luax_atexit(L, lovrJobSystemDestroy);
+  }
+
   return 1;
 }
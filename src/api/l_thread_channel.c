@@ -1,9 +1,13 @@
 #include "api.h"
 #include "thread/channel.h"
 #include "event/event.h"
+#include "data/blob.h"
+#include "core/ref.h"
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
-static void luax_checktimeout(lua_State* L, int index, double* timeout) {
+void luax_checktimeout(lua_State* L, int index, double* timeout) {
   switch (lua_type(L, index)) {
     case LUA_TNONE:
     case LUA_TNIL:
@@ -18,19 +22,185 @@ static void luax_checktimeout(lua_State* L, int index, double* timeout) {
   }
 }
 
+// Moving a Blob hands its memory to a new Blob owned by the message, leaving the original empty,
+// so the receiver gets the data without a copy and without sharing it with the sender.  Objects
+// like TextureData and Rasterizer keep pointers into the Blob they were created from, so a Blob
+// that anything else holds a reference to is copied instead (and nothing needs to be restored).
+static Blob* luax_moveblob(lua_State* L, int index, Variant* variant) {
+  Blob* blob = luax_totype(L, index, Blob);
+  lovrAssert(blob, "Only Blobs can be moved");
+  Blob* moved;
+
+  if (lovrRefCount(blob) > 1) {
+    void* data = malloc(blob->size);
+    lovrAssert(data || blob->size == 0, "Out of memory");
+    memcpy(data, blob->data, blob->size);
+    moved = lovrBlobCreate(data, blob->size, blob->name);
+    blob = NULL;
+  } else {
+    moved = lovrBlobCreate(blob->data, blob->size, blob->name);
+    moved->owner = blob->owner;
+    moved->destructor = blob->destructor;
+    blob->data = NULL;
+    blob->size = 0;
+    blob->owner = NULL;
+  }
+
+  variant->type = TYPE_OBJECT;
+  variant->value.object.pointer = moved;
+  variant->value.object.type = "Blob";
+  variant->value.object.destructor = lovrBlobDestroy;
+  return blob;
+}
+
 static int l_lovrChannelPush(lua_State* L) {
   Variant variant;
   double timeout;
+  Blob* source = NULL;
   Channel* channel = luax_checktype(L, 1, Channel);
-  luax_checkvariant(L, 2, &variant);
-  luax_checktimeout(L, 3, &timeout);
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "wait");
+    luax_checktimeout(L, -1, &timeout);
+    lua_getfield(L, 3, "move");
+    bool move = lua_toboolean(L, -1);
+    lua_pop(L, 2);
+    if (move) {
+      source = luax_moveblob(L, 2, &variant);
+    } else {
+      luax_checkvariant(L, 2, &variant);
+    }
+  } else {
+    luax_checkvariant(L, 2, &variant);
+    luax_checktimeout(L, 3, &timeout);
+  }
   uint64_t id;
   bool read = lovrChannelPush(channel, &variant, timeout, &id);
+
+  // Bounded channels wait for space instead of waiting for the message to be read
+  if (lovrChannelGetCapacity(channel) > 0 && !read) {
+    if (source) {
+      Blob* moved = variant.value.object.pointer;
+      source->data = moved->data;
+      source->size = moved->size;
+      source->owner = moved->owner;
+      moved->data = NULL;
+      moved->owner = NULL;
+    }
+    lovrVariantDestroy(&variant);
+    lua_pushnil(L);
+    lua_pushboolean(L, false);
+    return 2;
+  }
+
   lua_pushnumber(L, id);
-  lua_pushboolean(L, read);
+  lua_pushboolean(L, read && lovrChannelGetCapacity(channel) == 0);
   return 2;
 }
 
+typedef struct {
+  Variant* variants;
+  uint32_t count;
+  uint32_t converted;
+  bool table;
+} VariantList;
+
+// Called with the same arguments as the Channel method, except that the list replaces the Channel,
+// so the argument numbers in errors are the same
+static int checkVariants(lua_State* L) {
+  VariantList* list = lua_touserdata(L, 1);
+  for (uint32_t i = 0; i < list->count; i++) {
+    if (list->table) {
+      lua_rawgeti(L, 2, i + 1);
+      luax_checkvariant(L, -1, &list->variants[i]);
+      lua_pop(L, 1);
+    } else {
+      luax_checkvariant(L, i + 2, &list->variants[i]);
+    }
+    list->converted++;
+  }
+  return 0;
+}
+
+// Converts the arguments after the Channel (or the items of the table argument) to Variants.  A
+// value that can't be converted raises an error, so this runs as a protected call to destroy the
+// Variants before it first (along with the objects and strings they reference).
+static Variant* luax_checkvariants(lua_State* L, uint32_t count, bool table) {
+  VariantList list = { .variants = malloc(count * sizeof(Variant)), .count = count, .table = table };
+  lovrAssert(list.variants, "Out of memory");
+  int arguments = table ? 2 : count + 1;
+  luaL_checkstack(L, arguments + 1, "Too many messages");
+  lua_pushcfunction(L, checkVariants);
+  lua_pushlightuserdata(L, &list);
+  for (int i = 2; i <= arguments; i++) {
+    lua_pushvalue(L, i);
+  }
+
+  if (lua_pcall(L, arguments, 0, 0)) {
+    for (uint32_t i = 0; i < list.converted; i++) {
+      lovrVariantDestroy(&list.variants[i]);
+    }
+    free(list.variants);
+    lua_error(L);
+  }
+
+  return list.variants;
+}
+
+static int luax_pushmany(lua_State* L, Channel* channel, Variant* variants, uint32_t count, double timeout) {
+  uint64_t id;
+  uint32_t pushed = count;
+  bool read = lovrChannelPushMany(channel, variants, &pushed, timeout, &id);
+
+  for (uint32_t i = pushed; i < count; i++) {
+    lovrVariantDestroy(&variants[i]);
+  }
+
+  if (pushed > 0) {
+    lua_pushnumber(L, id);
+  } else {
+    lua_pushnil(L);
+  }
+
+  lua_pushboolean(L, read);
+  lua_pushinteger(L, pushed);
+  return 3;
+}
+
+static int l_lovrChannelPushMany(lua_State* L) {
+  Channel* channel = luax_checktype(L, 1, Channel);
+  uint32_t count = lua_gettop(L) - 1;
+  if (count == 0) {
+    lua_pushnil(L);
+    lua_pushboolean(L, false);
+    lua_pushinteger(L, 0);
+    return 3;
+  }
+
+  Variant* variants = luax_checkvariants(L, count, false);
+  int results = luax_pushmany(L, channel, variants, count, NAN);
+  free(variants);
+  return results;
+}
+
+static int l_lovrChannelPushTable(lua_State* L) {
+  double timeout;
+  Channel* channel = luax_checktype(L, 1, Channel);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  luax_checktimeout(L, 3, &timeout);
+  uint32_t count = luax_len(L, 2);
+  if (count == 0) {
+    lua_pushnil(L);
+    lua_pushboolean(L, false);
+    lua_pushinteger(L, 0);
+    return 3;
+  }
+
+  Variant* variants = luax_checkvariants(L, count, true);
+  int results = luax_pushmany(L, channel, variants, count, timeout);
+  free(variants);
+  return results;
+}
+
 static int l_lovrChannelPop(lua_State* L) {
   Variant variant;
   double timeout;
@@ -45,6 +215,37 @@ static int l_lovrChannelPop(lua_State* L) {
   return 1;
 }
 
+// Messages are drained in chunks so a huge max doesn't need a huge buffer.  Only the first chunk
+// waits; the rest just take whatever is already in the Channel.
+static int l_lovrChannelPopMany(lua_State* L) {
+  Variant variants[256];
+  double timeout;
+  Channel* channel = luax_checktype(L, 1, Channel);
+  lua_Integer n = luaL_optinteger(L, 2, UINT32_MAX);
+  luaL_argcheck(L, n >= 0, 2, "max can not be negative");
+  uint32_t max = (uint32_t) MIN(n, UINT32_MAX);
+  luax_checktimeout(L, 3, &timeout);
+  lua_newtable(L);
+
+  uint32_t total = 0;
+  while (total < max) {
+    uint32_t chunk = MIN(max - total, sizeof(variants) / sizeof(variants[0]));
+    uint32_t count = lovrChannelPopMany(channel, variants, chunk, total == 0 ? timeout : NAN);
+
+    for (uint32_t i = 0; i < count; i++) {
+      luax_pushvariant(L, &variants[i]);
+      lovrVariantDestroy(&variants[i]);
+      lua_rawseti(L, -2, ++total);
+    }
+
+    if (count < chunk) {
+      break;
+    }
+  }
+
+  return 1;
+}
+
 static int l_lovrChannelPeek(lua_State* L) {
   Variant variant;
   Channel* channel = luax_checktype(L, 1, Channel);
@@ -79,7 +280,10 @@ static int l_lovrChannelHasRead(lua_State* L) {
 
 const luaL_Reg lovrChannel[] = {
   { "push", l_lovrChannelPush },
+  { "pushMany", l_lovrChannelPushMany },
+  { "pushTable", l_lovrChannelPushTable },
   { "pop", l_lovrChannelPop },
+  { "popMany", l_lovrChannelPopMany },
   { "peek", l_lovrChannelPeek },
   { "clear", l_lovrChannelClear },
   { "getCount", l_lovrChannelGetCount },
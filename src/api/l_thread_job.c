@@ -0,0 +1,19 @@
+#include "api.h"
+#include "thread/job.h"
+
+static int l_lovrJobIsReady(lua_State* L) {
+  Job* job = luax_checktype(L, 1, Job);
+  lua_pushboolean(L, luax_isjobready(job));
+  return 1;
+}
+
+static int l_lovrJobAwait(lua_State* L) {
+  Job* job = luax_checktype(L, 1, Job);
+  return luax_awaitjob(L, job);
+}
+
+const luaL_Reg lovrJob[] = {
+  { "isReady", l_lovrJobIsReady },
+  { "await", l_lovrJobAwait },
+  { NULL, NULL }
+};
@@ -0,0 +1,50 @@
+#include "core/ref.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+// 64 bit atomics for lock-free queues, using the same compiler detection as core/ref.h.  Everything
+// is sequentially consistent.
+
+#ifndef LOVR_ENABLE_THREAD
+
+// Thread module is off, don't use atomics
+
+typedef uint64_t atomic64;
+static inline uint64_t atomic_load64(atomic64* p) { return *p; }
+static inline void atomic_store64(atomic64* p, uint64_t x) { *p = x; }
+static inline uint64_t atomic_add64(atomic64* p, int64_t x) { return *p += x; }
+static inline bool atomic_cas64(atomic64* p, uint64_t* expected, uint64_t x) {
+  return *p == *expected ? (*p = x, true) : (*expected = *p, false);
+}
+
+#elif defined(_MSC_VER)
+#include <intrin.h>
+typedef volatile __int64 atomic64;
+static inline uint64_t atomic_load64(atomic64* p) { return _InterlockedOr64(p, 0); }
+static inline void atomic_store64(atomic64* p, uint64_t x) { _InterlockedExchange64(p, x); }
+static inline uint64_t atomic_add64(atomic64* p, int64_t x) { return _InterlockedExchangeAdd64(p, x) + x; }
+static inline bool atomic_cas64(atomic64* p, uint64_t* expected, uint64_t x) {
+  uint64_t old = _InterlockedCompareExchange64(p, x, *expected);
+  return old == *expected ? true : (*expected = old, false);
+}
+#elif (defined(__GNUC_MINOR__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))) \
+   || (__has_builtin(__atomic_load_n) && __has_builtin(__atomic_compare_exchange_n))
+typedef uint64_t atomic64;
+static inline uint64_t atomic_load64(atomic64* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static inline void atomic_store64(atomic64* p, uint64_t x) { __atomic_store_n(p, x, __ATOMIC_SEQ_CST); }
+static inline uint64_t atomic_add64(atomic64* p, int64_t x) { return __atomic_add_fetch(p, x, __ATOMIC_SEQ_CST); }
+static inline bool atomic_cas64(atomic64* p, uint64_t* expected, uint64_t x) {
+  return __atomic_compare_exchange_n(p, expected, x, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+#else
+#include <stdatomic.h>
+typedef _Atomic(uint64_t) atomic64;
+static inline uint64_t atomic_load64(atomic64* p) { return atomic_load(p); }
+static inline void atomic_store64(atomic64* p, uint64_t x) { atomic_store(p, x); }
+static inline uint64_t atomic_add64(atomic64* p, int64_t x) { return atomic_fetch_add(p, x) + x; }
+static inline bool atomic_cas64(atomic64* p, uint64_t* expected, uint64_t x) {
+  return atomic_compare_exchange_weak(p, expected, x);
+}
+#endif
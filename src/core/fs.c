@@ -54,6 +54,12 @@ bool fs_write(fs_handle file, const void* buffer, size_t* bytes) {
   return success;
 }
 
+bool fs_seek(fs_handle file, uint64_t offset) {
+  LARGE_INTEGER distance;
+  distance.QuadPart = offset;
+  return SetFilePointerEx(file.handle, distance, NULL, FILE_BEGIN);
+}
+
 void* fs_map(const char* path, size_t* size) {
   WCHAR wpath[FS_PATH_MAX];
   if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, FS_PATH_MAX)) {
@@ -257,6 +263,10 @@ bool fs_write(fs_handle file, const void* buffer, size_t* bytes) {
   }
 }
 
+bool fs_seek(fs_handle file, uint64_t offset) {
+  return lseek(file.fd, (off_t) offset, SEEK_SET) >= 0;
+}
+
 void* fs_map(const char* path, size_t* size) {
   FileInfo info;
   fs_handle file;
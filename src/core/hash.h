@@ -1,12 +1,83 @@
 #include "util.h"
 #include <stdint.h>
+#include <string.h>
+
+// wyhash (final version 4), which reads 8 bytes at a time and mixes with a 64x64->128 multiply
+
+static LOVR_INLINE void hash_mum(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t) *a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static LOVR_INLINE uint64_t hash_mix(uint64_t a, uint64_t b) {
+  hash_mum(&a, &b);
+  return a ^ b;
+}
+
+static LOVR_INLINE uint64_t hash_read8(const uint8_t* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static LOVR_INLINE uint64_t hash_read4(const uint8_t* p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
 
-// FNV1a
 static LOVR_INLINE uint64_t hash64(const void* data, size_t length) {
-  const uint8_t* bytes = (uint8_t *)data;
-  uint64_t hash = 0xcbf29ce484222325;
-  for (size_t i = 0; i < length; i++) {
-    hash = (hash ^ bytes[i]) * 0x100000001b3;
+  static const uint64_t secret[4] = { 0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47 };
+  const uint8_t* p = data;
+  uint64_t seed = hash_mix(secret[0], secret[1]);
+  uint64_t a, b;
+
+  if (length <= 16) {
+    if (length >= 4) {
+      a = (hash_read4(p) << 32) | hash_read4(p + ((length >> 3) << 2));
+      b = (hash_read4(p + length - 4) << 32) | hash_read4(p + length - 4 - ((length >> 3) << 2));
+    } else if (length > 0) {
+      a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8) | p[length - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = length;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = hash_mix(hash_read8(p) ^ secret[1], hash_read8(p + 8) ^ seed);
+        see1 = hash_mix(hash_read8(p + 16) ^ secret[2], hash_read8(p + 24) ^ see1);
+        see2 = hash_mix(hash_read8(p + 32) ^ secret[3], hash_read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+
+    while (i > 16) {
+      seed = hash_mix(hash_read8(p) ^ secret[1], hash_read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+
+    a = hash_read8(p + i - 16);
+    b = hash_read8(p + i - 8);
   }
-  return hash;
+
+  a ^= secret[1];
+  b ^= seed;
+  hash_mum(&a, &b);
+  return hash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
 }
@@ -10,6 +10,18 @@
 #define MAF static LOVR_INLINE
 #endif
 
+// The matrix kernels use SSE or NEON when the compiler targets them, which can be turned off by
+// defining MAF_NO_SIMD.  Loads and stores are unaligned, so matrices don't need special storage.
+#ifndef MAF_NO_SIMD
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MAF_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MAF_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 typedef float* vec3;
 typedef float* quat;
 typedef float* mat4;
@@ -372,7 +384,82 @@ MAF mat4 mat4_transpose(mat4 m) {
   return m;
 }
 
+#ifdef MAF_SSE
+#define MAF_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define MAF_SWIZZLE(a, x, y, z, w) MAF_SHUFFLE(a, a, x, y, z, w)
+
+// 2x2 matrix products on vectors holding a 2x2 matrix each: a * b, adj(a) * b, and a * adj(b)
+static LOVR_INLINE __m128 maf_mat2Mul(__m128 a, __m128 b) {
+  return _mm_add_ps(_mm_mul_ps(a, MAF_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(MAF_SWIZZLE(a, 1, 0, 3, 2), MAF_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+static LOVR_INLINE __m128 maf_mat2AdjMul(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(MAF_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(MAF_SWIZZLE(a, 1, 1, 2, 2), MAF_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+static LOVR_INLINE __m128 maf_mat2MulAdj(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(a, MAF_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(MAF_SWIZZLE(a, 1, 0, 3, 2), MAF_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// The columns c0-c3 weighted by the components of v, added in order
+static LOVR_INLINE __m128 maf_combine(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v) {
+  __m128 x = _mm_mul_ps(c0, MAF_SWIZZLE(v, 0, 0, 0, 0));
+  x = _mm_add_ps(x, _mm_mul_ps(c1, MAF_SWIZZLE(v, 1, 1, 1, 1)));
+  x = _mm_add_ps(x, _mm_mul_ps(c2, MAF_SWIZZLE(v, 2, 2, 2, 2)));
+  return _mm_add_ps(x, _mm_mul_ps(c3, MAF_SWIZZLE(v, 3, 3, 3, 3)));
+}
+#endif
+
 MAF mat4 mat4_invert(mat4 m) {
+#ifdef MAF_SSE
+  // Blockwise inversion using the 2x2 blocks of the matrix.  Treating the columns as rows inverts
+  // the transpose, which is the transpose of the inverse, so the layout works out the same.
+  __m128 c0 = _mm_loadu_ps(m + 0);
+  __m128 c1 = _mm_loadu_ps(m + 4);
+  __m128 c2 = _mm_loadu_ps(m + 8);
+  __m128 c3 = _mm_loadu_ps(m + 12);
+
+  __m128 A = _mm_movelh_ps(c0, c1);
+  __m128 B = _mm_movehl_ps(c1, c0);
+  __m128 C = _mm_movelh_ps(c2, c3);
+  __m128 D = _mm_movehl_ps(c3, c2);
+
+  __m128 dets = _mm_sub_ps(
+    _mm_mul_ps(MAF_SHUFFLE(c0, c2, 0, 2, 0, 2), MAF_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+    _mm_mul_ps(MAF_SHUFFLE(c0, c2, 1, 3, 1, 3), MAF_SHUFFLE(c1, c3, 0, 2, 0, 2))
+  );
+
+  __m128 detA = MAF_SWIZZLE(dets, 0, 0, 0, 0);
+  __m128 detB = MAF_SWIZZLE(dets, 1, 1, 1, 1);
+  __m128 detC = MAF_SWIZZLE(dets, 2, 2, 2, 2);
+  __m128 detD = MAF_SWIZZLE(dets, 3, 3, 3, 3);
+
+  __m128 DC = maf_mat2AdjMul(D, C);
+  __m128 AB = maf_mat2AdjMul(A, B);
+  __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), maf_mat2Mul(B, DC));
+  __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), maf_mat2Mul(C, AB));
+  __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), maf_mat2MulAdj(D, AB));
+  __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), maf_mat2MulAdj(A, DC));
+
+  __m128 trace = _mm_mul_ps(AB, MAF_SWIZZLE(DC, 0, 2, 1, 3));
+  trace = _mm_add_ps(trace, MAF_SWIZZLE(trace, 2, 3, 0, 1));
+  trace = _mm_add_ps(trace, MAF_SWIZZLE(trace, 1, 0, 3, 2));
+
+  __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+  if (_mm_cvtss_f32(det) == 0.f) { return m; }
+
+  __m128 invDet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+  X = _mm_mul_ps(X, invDet);
+  Y = _mm_mul_ps(Y, invDet);
+  Z = _mm_mul_ps(Z, invDet);
+  W = _mm_mul_ps(W, invDet);
+
+  _mm_storeu_ps(m + 0, MAF_SHUFFLE(X, Y, 3, 1, 3, 1));
+  _mm_storeu_ps(m + 4, MAF_SHUFFLE(X, Y, 2, 0, 2, 0));
+  _mm_storeu_ps(m + 8, MAF_SHUFFLE(Z, W, 3, 1, 3, 1));
+  _mm_storeu_ps(m + 12, MAF_SHUFFLE(Z, W, 2, 0, 2, 0));
+  return m;
+#else
   float a00 = m[0], a01 = m[1], a02 = m[2], a03 = m[3],
         a10 = m[4], a11 = m[5], a12 = m[6], a13 = m[7],
         a20 = m[8], a21 = m[9], a22 = m[10], a23 = m[11],
@@ -415,9 +502,43 @@ MAF mat4 mat4_invert(mat4 m) {
   m[15] = (a20 * b03 - a21 * b01 + a22 * b00) * invDet;
 
   return m;
+#endif
 }
 
+// The vectorized versions add the products in the same order as the scalar code, so they give the
+// same results (as long as the compiler doesn't contract them into fused multiply-adds)
 MAF mat4 mat4_multiply(mat4 m, mat4 n) {
+#if defined(MAF_SSE)
+  // Both matrices are loaded before anything is stored, since n can be m
+  __m128 c0 = _mm_loadu_ps(m + 0);
+  __m128 c1 = _mm_loadu_ps(m + 4);
+  __m128 c2 = _mm_loadu_ps(m + 8);
+  __m128 c3 = _mm_loadu_ps(m + 12);
+  __m128 r0 = _mm_loadu_ps(n + 0);
+  __m128 r1 = _mm_loadu_ps(n + 4);
+  __m128 r2 = _mm_loadu_ps(n + 8);
+  __m128 r3 = _mm_loadu_ps(n + 12);
+  _mm_storeu_ps(m + 0, maf_combine(c0, c1, c2, c3, r0));
+  _mm_storeu_ps(m + 4, maf_combine(c0, c1, c2, c3, r1));
+  _mm_storeu_ps(m + 8, maf_combine(c0, c1, c2, c3, r2));
+  _mm_storeu_ps(m + 12, maf_combine(c0, c1, c2, c3, r3));
+  return m;
+#elif defined(MAF_NEON)
+  float32x4_t c0 = vld1q_f32(m + 0);
+  float32x4_t c1 = vld1q_f32(m + 4);
+  float32x4_t c2 = vld1q_f32(m + 8);
+  float32x4_t c3 = vld1q_f32(m + 12);
+  float r[16];
+  memcpy(r, n, sizeof(r));
+  for (int i = 0; i < 16; i += 4) {
+    float32x4_t x = vmulq_n_f32(c0, r[i + 0]);
+    x = vaddq_f32(x, vmulq_n_f32(c1, r[i + 1]));
+    x = vaddq_f32(x, vmulq_n_f32(c2, r[i + 2]));
+    x = vaddq_f32(x, vmulq_n_f32(c3, r[i + 3]));
+    vst1q_f32(m + i, x);
+  }
+  return m;
+#else
   float m00 = m[0], m01 = m[1], m02 = m[2], m03 = m[3],
         m10 = m[4], m11 = m[5], m12 = m[6], m13 = m[7],
         m20 = m[8], m21 = m[9], m22 = m[10], m23 = m[11],
@@ -445,9 +566,25 @@ MAF mat4 mat4_multiply(mat4 m, mat4 n) {
   m[14] = n30 * m02 + n31 * m12 + n32 * m22 + n33 * m32;
   m[15] = n30 * m03 + n31 * m13 + n32 * m23 + n33 * m33;
   return m;
+#endif
 }
 
 MAF float* mat4_multiplyVec4(mat4 m, float* v) {
+#if defined(MAF_SSE)
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(v[0]));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+  _mm_storeu_ps(v, x);
+  return v;
+#elif defined(MAF_NEON)
+  float32x4_t x = vmulq_n_f32(vld1q_f32(m + 0), v[0]);
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 4), v[1]));
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 8), v[2]));
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 12), v[3]));
+  vst1q_f32(v, x);
+  return v;
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + v[3] * m[12];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + v[3] * m[13];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + v[3] * m[14];
@@ -457,6 +594,7 @@ MAF float* mat4_multiplyVec4(mat4 m, float* v) {
   v[2] = z;
   v[3] = w;
   return v;
+#endif
 }
 
 MAF mat4 mat4_translate(mat4 m, float x, float y, float z) {
@@ -603,6 +741,24 @@ MAF mat4 mat4_lookAt(mat4 m, vec3 from, vec3 to, vec3 up) {
 }
 
 MAF void mat4_transform(mat4 m, vec3 v) {
+#if defined(MAF_SSE)
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(v[0]));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+  x = _mm_add_ps(x, _mm_loadu_ps(m + 12));
+  _mm_storeu_ps(v, _mm_div_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3))));
+#elif defined(MAF_NEON)
+  float32x4_t x = vmulq_n_f32(vld1q_f32(m + 0), v[0]);
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 4), v[1]));
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 8), v[2]));
+  x = vaddq_f32(x, vld1q_f32(m + 12));
+  float w = vgetq_lane_f32(x, 3);
+  vst1q_f32(v, x);
+  v[0] /= w;
+  v[1] /= w;
+  v[2] /= w;
+  v[3] /= w;
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + m[12];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + m[13];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + m[14];
@@ -611,6 +767,7 @@ MAF void mat4_transform(mat4 m, vec3 v) {
   v[1] = y / w;
   v[2] = z / w;
   v[3] = w / w;
+#endif
 }
 
 MAF void mat4_transform_project(mat4 m, vec3 v) {
@@ -625,6 +782,17 @@ MAF void mat4_transform_project(mat4 m, vec3 v) {
 }
 
 MAF void mat4_transformDirection(mat4 m, vec3 v) {
+#if defined(MAF_SSE)
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(v[0]));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+  x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+  _mm_storeu_ps(v, x);
+#elif defined(MAF_NEON)
+  float32x4_t x = vmulq_n_f32(vld1q_f32(m + 0), v[0]);
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 4), v[1]));
+  x = vaddq_f32(x, vmulq_n_f32(vld1q_f32(m + 8), v[2]));
+  vst1q_f32(v, x);
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10];
@@ -633,4 +801,5 @@ MAF void mat4_transformDirection(mat4 m, vec3 v) {
   v[1] = y;
   v[2] = z;
   v[3] = w;
+#endif
 }
@@ -12,24 +12,59 @@ static uint32_t prevpo2(uint32_t x) {
   return x - (x >> 1);
 }
 
+// Robin Hood hashing: entries are kept sorted by their distance from their ideal slot, so lookups
+// can stop as soon as they pass an entry that is closer to home than the key would be, and removal
+// shifts the following entries back instead of leaving tombstones.
+
+static LOVR_INLINE uint64_t map_distance(map_t* map, uint64_t hash, uint64_t index) {
+  return (index - hash) & (map->size - 1);
+}
+
+static void map_insert(map_t* map, uint64_t hash, uint64_t value) {
+  uint64_t mask = map->size - 1;
+  uint64_t h = hash & mask;
+
+  for (uint64_t distance = 0;; distance++, h = (h + 1) & mask) {
+    uint64_t x = map->hashes[h];
+
+    if (x == MAP_NIL) {
+      map->hashes[h] = hash;
+      map->values[h] = value;
+      map->used++;
+      return;
+    }
+
+    if (x == hash) {
+      map->values[h] = value;
+      return;
+    }
+
+    // Steal the slot from richer entries and keep going with the one that was displaced
+    uint64_t d = map_distance(map, x, h);
+    if (d < distance) {
+      uint64_t v = map->values[h];
+      map->hashes[h] = hash;
+      map->values[h] = value;
+      hash = x;
+      value = v;
+      distance = d;
+    }
+  }
+}
+
 static void map_rehash(map_t* map) {
   map_t old = *map;
   map->size <<= 1;
+  map->used = 0;
   map->hashes = malloc(2 * map->size * sizeof(uint64_t));
   map->values = map->hashes + map->size;
   lovrAssert(map->size && map->hashes, "Out of memory");
   memset(map->hashes, 0xff, 2 * map->size * sizeof(uint64_t));
 
   if (old.hashes) {
-    uint64_t mask = map->size - 1;
     for (uint32_t i = 0; i < old.size; i++) {
       if (old.hashes[i] != MAP_NIL) {
-        uint64_t index = old.hashes[i] & mask;
-        while (map->hashes[index] != MAP_NIL) {
-          index = (index + 1) & mask;
-        }
-        map->hashes[index] = old.hashes[i];
-        map->values[index] = old.values[i];
+        map_insert(map, old.hashes[i], old.values[i]);
       }
     }
     free(old.hashes);
@@ -40,11 +75,14 @@ static LOVR_INLINE uint64_t map_find(map_t* map, uint64_t hash) {
   uint64_t mask = map->size - 1;
   uint64_t h = hash & mask;
 
-  while (map->hashes[h] != hash && map->hashes[h] != MAP_NIL) {
-    h = (h + 1) & mask;
+  for (uint64_t distance = 0;; distance++, h = (h + 1) & mask) {
+    uint64_t x = map->hashes[h];
+    if (x == hash) {
+      return h;
+    } else if (x == MAP_NIL || map_distance(map, x, h) < distance) {
+      return MAP_NIL;
+    }
   }
-
-  return h;
 }
 
 void map_init(map_t* map, uint32_t n) {
@@ -59,7 +97,8 @@ void map_free(map_t* map) {
 }
 
 uint64_t map_get(map_t* map, uint64_t hash) {
-  return map->values[map_find(map, hash)];
+  uint64_t h = map_find(map, hash);
+  return h == MAP_NIL ? MAP_NIL : map->values[h];
 }
 
 void map_set(map_t* map, uint64_t hash, uint64_t value) {
@@ -67,34 +106,24 @@ void map_set(map_t* map, uint64_t hash, uint64_t value) {
     map_rehash(map);
   }
 
-  uint64_t h = map_find(map, hash);
-  map->used += map->hashes[h] == MAP_NIL;
-  map->hashes[h] = hash;
-  map->values[h] = value;
+  map_insert(map, hash, value);
 }
 
 void map_remove(map_t* map, uint64_t hash) {
   uint64_t h = map_find(map, hash);
 
-  if (map->hashes[h] == MAP_NIL) {
+  if (h == MAP_NIL) {
     return;
   }
 
   uint64_t mask = map->size - 1;
-  uint64_t i = h;
-
-  do {
-    i = (i + 1) & mask;
-    uint64_t x = map->hashes[i] & mask;
-    // Removing a key from an open-addressed hash table is complicated
-    if ((i > h && (x <= h || x > i)) || (i < h && (x <= h && x > i))) {
-      map->hashes[h] = map->hashes[i];
-      map->values[h] = map->values[i];
-      h = i;
-    }
-  } while (map->hashes[i] != MAP_NIL);
+  for (uint64_t i = (h + 1) & mask; map->hashes[i] != MAP_NIL && map_distance(map, map->hashes[i], i) > 0; i = (i + 1) & mask) {
+    map->hashes[h] = map->hashes[i];
+    map->values[h] = map->values[i];
+    h = i;
+  }
 
-  map->hashes[i] = MAP_NIL;
-  map->values[i] = MAP_NIL;
+  map->hashes[h] = MAP_NIL;
+  map->values[h] = MAP_NIL;
   map->used--;
 }
@@ -59,6 +59,7 @@ const char* lovrPlatformGetName(void);
 double lovrPlatformGetTime(void);
 void lovrPlatformSetTime(double t);
 void lovrPlatformSleep(double seconds);
+uint32_t lovrPlatformGetProcessorCount(void);
 void lovrPlatformOpenConsole(void);
 void lovrPlatformPollEvents(void);
 bool lovrPlatformCreateWindow(WindowFlags* flags);
@@ -92,3 +92,8 @@ bool lovrPlatformIsKeyDown(KeyCode key) {
 void lovrPlatformSleep(double seconds) {
   usleep((unsigned int) (seconds * 1000000));
 }
+
+uint32_t lovrPlatformGetProcessorCount() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t) count : 1;
+}
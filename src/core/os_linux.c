@@ -1,6 +1,7 @@
 #include "os.h"
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "os_glfw.h"
 
@@ -42,6 +43,11 @@ void lovrPlatformSleep(double seconds) {
   while (nanosleep(&t, &t));
 }
 
+uint32_t lovrPlatformGetProcessorCount() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t) count : 1;
+}
+
 void lovrPlatformOpenConsole() {
   //
 }
@@ -2,6 +2,7 @@
 #include <mach-o/dyld.h>
 #include <mach/mach_time.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "os_glfw.h"
 
@@ -44,6 +45,11 @@ void lovrPlatformSleep(double seconds) {
   while (nanosleep(&t, &t));
 }
 
+uint32_t lovrPlatformGetProcessorCount() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t) count : 1;
+}
+
 void lovrPlatformOpenConsole() {
   //
 }
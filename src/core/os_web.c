@@ -31,6 +31,10 @@ void lovrPlatformSleep(double seconds) {
   emscripten_sleep((unsigned int) (seconds * 1000 + .5));
 }
 
+uint32_t lovrPlatformGetProcessorCount() {
+  return 1;
+}
+
 void lovrPlatformOpenConsole() {
   //
 }
@@ -41,6 +41,12 @@ void lovrPlatformSleep(double seconds) {
   Sleep((unsigned int) (seconds * 1000));
 }
 
+uint32_t lovrPlatformGetProcessorCount() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
 void lovrPlatformOpenConsole() {
   if (AttachConsole(ATTACH_PARENT_PROCESS)) {
     freopen("CONOUT$", "w", stdout);
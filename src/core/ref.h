@@ -14,6 +14,7 @@
 typedef uint32_t Ref;
 static inline uint32_t ref_inc(Ref* ref) { return ++*ref; }
 static inline uint32_t ref_dec(Ref* ref) { return --*ref; }
+static inline uint32_t ref_get(Ref* ref) { return *ref; }
 
 #elif defined(_MSC_VER)
 
@@ -23,6 +24,7 @@ static inline uint32_t ref_dec(Ref* ref) { return --*ref; }
 typedef uint32_t Ref;
 static inline uint32_t ref_inc(Ref* ref) { return _InterlockedIncrement(ref); }
 static inline uint32_t ref_dec(Ref* ref) { return _InterlockedDecrement(ref); }
+static inline uint32_t ref_get(Ref* ref) { return *(volatile Ref*) ref; }
 
 #elif (defined(__GNUC_MINOR__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))) \
    || (__has_builtin(__atomic_add_fetch) && __has_builtin(__atomic_sub_fetch))
@@ -32,6 +34,7 @@ static inline uint32_t ref_dec(Ref* ref) { return _InterlockedDecrement(ref); }
 typedef uint32_t Ref;
 static inline uint32_t ref_inc(Ref* ref) { return __atomic_add_fetch(ref, 1, __ATOMIC_SEQ_CST); }
 static inline uint32_t ref_dec(Ref* ref) { return __atomic_sub_fetch(ref, 1, __ATOMIC_SEQ_CST); }
+static inline uint32_t ref_get(Ref* ref) { return __atomic_load_n(ref, __ATOMIC_SEQ_CST); }
 
 #else
 
@@ -46,12 +49,14 @@ static inline uint32_t ref_dec(Ref* ref) { return __atomic_sub_fetch(ref, 1, __A
 typedef _Atomic(uint32_t) Ref;
 static inline uint32_t ref_inc(Ref* ref) { return atomic_fetch_add(ref, 1) + 1; }
 static inline uint32_t ref_dec(Ref* ref) { return atomic_fetch_sub(ref, 1) - 1; }
+static inline uint32_t ref_get(Ref* ref) { return atomic_load(ref); }
 
 #endif
 
 void* _lovrAlloc(size_t size);
 #define toRef(o) ((Ref*) (((char*) (o)) - sizeof(size_t)))
 #define lovrAlloc(T) (T*) _lovrAlloc(sizeof(T))
+#define lovrRefCount(o) ref_get(toRef(o))
 #define lovrRetain(o) if (o && !ref_inc(toRef(o))) { lovrThrow("Refcount overflow in %s:%d", __FILE__, __LINE__); }
 #define lovrRelease(T, o) if (o && !ref_dec(toRef(o))) lovr ## T ## Destroy(o), free(toRef(o));
 #define _lovrRelease(o, f) if (o && !ref_dec(toRef(o))) f(o), free(toRef(o));
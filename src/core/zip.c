@@ -1,36 +1,79 @@
 #include "zip.h"
+#include <stdlib.h>
 #include <string.h>
 
 static uint16_t readu16(const uint8_t* p) { uint16_t x; memcpy(&x, p, sizeof(x)); return x; }
 static uint32_t readu32(const uint8_t* p) { uint32_t x; memcpy(&x, p, sizeof(x)); return x; }
+static uint64_t readu64(const uint8_t* p) { uint64_t x; memcpy(&x, p, sizeof(x)); return x; }
 
 bool zip_open(zip_state* zip) {
-  const uint8_t* p = zip->data + zip->size - 22;
+  if (zip->size < 22) {
+    return false;
+  }
+
+  // The endOfCentralDirectory can be followed by a comment of up to 64KB, so search backwards for it
+  const uint8_t* p = NULL;
+  size_t min = zip->size > 22 + 0xffff ? zip->size - 22 - 0xffff : 0;
+  for (size_t i = zip->size - 22 + 1; i-- > min;) {
+    const uint8_t* q = zip->data + i;
+    if (readu32(q) == 0x06054b50 && i + 22 + readu16(q + 20) <= zip->size) {
+      p = q;
+      break;
+    }
+  }
 
-  if (zip->size < 22 || readu32(p) != 0x06054b50) {
+  if (!p) {
     return false;
   }
 
+  size_t offsetOfEndOfCentralDirectory = p - zip->data;
+  uint64_t sizeOfCentralDirectory = readu32(p + 12);
   zip->count = readu16(p + 10);
   zip->cursor = readu32(p + 16);
   zip->base = 0;
 
-  if (zip->cursor + 4 > zip->size) {
+  // Zip64 archives have a locator right before the endOfCentralDirectory, pointing to a bigger
+  // record with 64 bit counts and offsets.  The record is normally right before the locator, which
+  // is where to look if the locator is wrong (self-extracting archives again, see below).
+  if (offsetOfEndOfCentralDirectory >= 20 && readu32(p - 20) == 0x07064b50) {
+    uint64_t offset = readu64(p - 20 + 8);
+
+    if (offsetOfEndOfCentralDirectory < 20 + 56) {
+      return false;
+    }
+
+    if (offset > offsetOfEndOfCentralDirectory - 20 - 56 || readu32(zip->data + offset) != 0x06064b50) {
+      offset = offsetOfEndOfCentralDirectory - 20 - 56;
+      if (readu32(zip->data + offset) != 0x06064b50) {
+        return false;
+      }
+    }
+
+    const uint8_t* record = zip->data + offset;
+    zip->count = readu64(record + 32);
+    sizeOfCentralDirectory = readu64(record + 40);
+    zip->cursor = readu64(record + 48);
+    offsetOfEndOfCentralDirectory = offset;
+  }
+
+  if (zip->cursor > zip->size - 4) {
     return false;
   }
 
   // See if the central directory starts where the endOfCentralDirectory said it would.
   // If it doesn't, then it might be a self-extracting archive with broken offsets (common).
-  // In this case, assume the central directory is directly adjacent to the endOfCentralDirectory,
-  // located at (offsetOfEndOfCentralDirectory (aka size - 22) - sizeOfCentralDirectory).
+  // In this case, assume the central directory is directly adjacent to the endOfCentralDirectory
+  // (or the Zip64 record), located at (offsetOfEndOfCentralDirectory - sizeOfCentralDirectory).
   // If we find a central directory there, then compute a "base" offset that equals the difference
   // between where it is and where it was supposed to be, and apply this offset to everything else.
   if (readu32(zip->data + zip->cursor) != 0x02014b50) {
-    size_t offsetOfEndOfCentralDirectory = zip->size - 22;
-    size_t sizeOfCentralDirectory = readu32(p + 12);
-    size_t centralDirectoryOffset = offsetOfEndOfCentralDirectory - sizeOfCentralDirectory;
+    if (sizeOfCentralDirectory > offsetOfEndOfCentralDirectory) {
+      return false;
+    }
+
+    uint64_t centralDirectoryOffset = offsetOfEndOfCentralDirectory - sizeOfCentralDirectory;
 
-    if (sizeOfCentralDirectory > offsetOfEndOfCentralDirectory || centralDirectoryOffset + 4 > zip->size) {
+    if (centralDirectoryOffset + 4 > zip->size) {
       return false;
     }
 
@@ -52,17 +95,57 @@ bool zip_next(zip_state* zip, zip_file* file) {
     return false;
   }
 
+  uint16_t extraLength = readu16(p + 30);
   file->mtime = readu16(p + 12);
   file->mdate = readu16(p + 14);
+  file->csize = readu32(p + 20);
   file->size = readu32(p + 24);
   file->length = readu16(p + 28);
-  file->offset = readu32(p + 42) + zip->base;
+  file->offset = readu32(p + 42);
   file->name = (const char*) (p + 46);
-  zip->cursor += 46 + file->length + readu16(p + 30) + readu16(p + 32);
+
+  if (zip->cursor + 46 + file->length + extraLength > zip->size) {
+    return false;
+  }
+
+  // Sizes and offsets that don't fit in 32 bits are in the Zip64 extra field, in a fixed order, but
+  // only the ones that overflowed are there
+  if (file->size == 0xffffffff || file->csize == 0xffffffff || file->offset == 0xffffffff) {
+    const uint8_t* extra = p + 46 + file->length;
+    const uint8_t* end = extra + extraLength;
+    while (extra + 4 <= end) {
+      uint16_t id = readu16(extra);
+      uint16_t length = readu16(extra + 2);
+      const uint8_t* field = extra + 4;
+      const uint8_t* fieldEnd = field + length;
+      if (fieldEnd > end) {
+        return false;
+      }
+
+      if (id == 0x0001) {
+        uint64_t* values[] = { &file->size, &file->csize, &file->offset };
+        for (int i = 0; i < 3; i++) {
+          if (*values[i] == 0xffffffff) {
+            if (field + 8 > fieldEnd) return false;
+            *values[i] = readu64(field);
+            field += 8;
+          }
+        }
+        break;
+      }
+
+      extra = fieldEnd;
+    }
+  }
+
+  file->offset += zip->base;
+  zip->cursor += 46 + file->length + extraLength + readu16(p + 32);
   return zip->cursor < zip->size;
 }
 
-void* zip_load(zip_state* zip, size_t offset, size_t* csize, bool* compressed) {
+// The compressed size comes from the central directory, since the local header doesn't have it
+// when the archive was written as a stream (or uses Zip64)
+void* zip_load(zip_state* zip, uint64_t offset, uint64_t csize, uint16_t* method) {
   if (zip->size < 30 || offset > zip->size - 30) {
     return NULL;
   }
@@ -72,13 +155,509 @@ void* zip_load(zip_state* zip, size_t offset, size_t* csize, bool* compressed) {
     return NULL;
   }
 
-  uint16_t compression;
-  *compressed = compression = readu16(p + 8);
-  if (compression != 0 && compression != 8) {
-    return false;
+  *method = readu16(p + 8);
+  if (*method != ZIP_STORE && *method != ZIP_DEFLATE && *method != ZIP_ZSTD && *method != ZIP_LZ4) {
+    return NULL;
   }
 
-  *csize = readu32(p + 18);
+  // The name and extra field lengths come from the archive too, so they can run past the end
   uint32_t skip = readu16(p + 26) + readu16(p + 28);
-  return offset + 30 + skip + *csize > zip->size ? NULL : (p + 30 + skip);
+  if (skip > zip->size - offset - 30) {
+    return NULL;
+  }
+
+  return csize > zip->size - offset - 30 - skip ? NULL : (p + 30 + skip);
+}
+
+// LZ4
+
+static bool lz4_length(const uint8_t** p, const uint8_t* end, size_t* length) {
+  uint8_t byte;
+  do {
+    if (*p == end) return false;
+    byte = *(*p)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// Decodes one block onto the end of the output.  Matches can reach back into earlier blocks, since
+// the whole output is in one buffer (so linked and independent blocks both work).
+static bool lz4_block(const uint8_t* p, const uint8_t* end, uint8_t* dst, size_t* cursor, size_t size) {
+  uint8_t* out = dst + *cursor;
+  uint8_t* limit = dst + size;
+
+  while (p < end && out < limit) {
+    uint8_t token = *p++;
+
+    // Short literals are copied 16 bytes at a time when there's room, instead of a variable memcpy
+    size_t length = token >> 4;
+    if (length < 15 && end - p >= 16 && limit - out >= 16) {
+      memcpy(out, p, 16);
+      out += length;
+      p += length;
+    } else {
+      if (length == 15 && !lz4_length(&p, end, &length)) return false;
+      if (length > (size_t) (end - p)) return false;
+      size_t n = length < (size_t) (limit - out) ? length : (size_t) (limit - out);
+      memcpy(out, p, n);
+      out += n;
+      p += length;
+    }
+
+    // The last sequence is only literals
+    if (p == end || out == limit) break;
+    if (end - p < 2) return false;
+
+    size_t distance = readu16(p);
+    p += 2;
+    if (distance == 0 || distance > (size_t) (out - dst)) return false;
+
+    length = token & 15;
+    if (length == 15 && !lz4_length(&p, end, &length)) return false;
+    length += 4;
+    size_t n = length < (size_t) (limit - out) ? length : (size_t) (limit - out);
+
+    // Matches are copied in chunks that can run past the end (it gets overwritten later), which
+    // works for overlapping matches as long as the chunk is no bigger than the distance
+    const uint8_t* match = out - distance;
+    if (distance >= 16 && (size_t) (limit - out) >= n + 16) {
+      for (size_t i = 0; i < n; i += 16) memcpy(out + i, match + i, 16);
+    } else if (distance >= 8 && (size_t) (limit - out) >= n + 8) {
+      for (size_t i = 0; i < n; i += 8) memcpy(out + i, match + i, 8);
+    } else {
+      for (size_t i = 0; i < n; i++) out[i] = match[i];
+    }
+    out += n;
+  }
+
+  *cursor = out - dst;
+  return true;
+}
+
+// Decodes the first size bytes of an LZ4 frame.  Checksums are skipped (zip has its own CRC), and
+// frames that need a dictionary aren't supported.
+bool zip_lz4(const void* src, uint64_t csize, void* dst, size_t size) {
+  const uint8_t* p = src;
+  const uint8_t* end = p + csize;
+
+  if (csize < 7 || readu32(p) != 0x184d2204) {
+    return false;
+  }
+
+  uint8_t flags = p[4];
+  bool blockChecksums = flags & 0x10;
+  bool contentSize = flags & 0x08;
+  if ((flags >> 6) != 1 || (flags & 0x01)) {
+    return false;
+  }
+
+  size_t header = 7 + (contentSize ? 8 : 0);
+  if (csize < header) {
+    return false;
+  }
+
+  size_t cursor = 0;
+  p += header;
+  while (cursor < size) {
+    if (end - p < 4) return false;
+    uint32_t block = readu32(p);
+    uint32_t length = block & 0x7fffffff;
+    p += 4;
+
+    if (block == 0) break;
+    if (length > (size_t) (end - p)) return false;
+
+    if (block & 0x80000000) {
+      size_t n = length < size - cursor ? length : size - cursor;
+      memcpy((uint8_t*) dst + cursor, p, n);
+      cursor += n;
+    } else if (!lz4_block(p, p + length, dst, &cursor, size)) {
+      return false;
+    }
+
+    p += length;
+    if (blockChecksums) {
+      if (end - p < 4) return false;
+      p += 4;
+    }
+  }
+
+  return cursor == size;
+}
+
+// Inflate
+
+#define WINDOW_SIZE 65536
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define FILL_MAX (32768 - 258)
+
+enum { MODE_HEADER, MODE_STORED, MODE_HUFFMAN, MODE_DONE };
+
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163,
+  195, 227, 258
+};
+
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049,
+  3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static uint32_t reverse16(uint32_t x) {
+  x = ((x & 0xaaaa) >> 1) | ((x & 0x5555) << 1);
+  x = ((x & 0xcccc) >> 2) | ((x & 0x3333) << 2);
+  x = ((x & 0xf0f0) >> 4) | ((x & 0x0f0f) << 4);
+  x = ((x & 0xff00) >> 8) | ((x & 0x00ff) << 8);
+  return x;
+}
+
+// Canonical Huffman codes, with a table for codes up to 9 bits and a search for longer ones
+static bool buildHuffman(zip_huffman* h, const uint8_t* lengths, uint32_t n) {
+  uint32_t count[17] = { 0 };
+  uint32_t next[16];
+
+  memset(h->fast, 0, sizeof(h->fast));
+  for (uint32_t i = 0; i < n; i++) {
+    count[lengths[i]]++;
+  }
+
+  count[0] = 0;
+  for (uint32_t i = 1; i < 16; i++) {
+    if (count[i] > (1u << i)) {
+      return false;
+    }
+  }
+
+  uint32_t code = 0;
+  uint32_t symbol = 0;
+  for (uint32_t i = 1; i < 16; i++) {
+    next[i] = code;
+    h->firstCode[i] = code;
+    h->firstSymbol[i] = symbol;
+    code += count[i];
+    if (count[i] && code - 1 >= (1u << i)) {
+      return false;
+    }
+    h->maxCode[i] = code << (16 - i);
+    code <<= 1;
+    symbol += count[i];
+  }
+  h->maxCode[16] = 0x10000;
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t s = lengths[i];
+    if (s) {
+      uint32_t c = next[s] - h->firstCode[s] + h->firstSymbol[s];
+      h->size[c] = s;
+      h->value[c] = i;
+      if (s <= 9) {
+        for (uint32_t j = reverse16(next[s]) >> (16 - s); j < 512; j += 1 << s) {
+          h->fast[j] = (s << 9) | i;
+        }
+      }
+      next[s]++;
+    }
+  }
+
+  return true;
+}
+
+static void refill(zip_stream* stream) {
+  while (stream->bitCount <= 56 && stream->cursor < stream->csize) {
+    stream->bits |= (uint64_t) stream->src[stream->cursor++] << stream->bitCount;
+    stream->bitCount += 8;
+  }
+}
+
+static uint32_t getBits(zip_stream* stream, uint32_t n) {
+  if (stream->bitCount < n) {
+    refill(stream);
+    if (stream->bitCount < n) {
+      stream->error = true;
+      return 0;
+    }
+  }
+
+  uint32_t x = stream->bits & ((1ull << n) - 1);
+  stream->bits >>= n;
+  stream->bitCount -= n;
+  return x;
+}
+
+static uint32_t decode(zip_stream* stream, zip_huffman* h) {
+  if (stream->bitCount < 16) {
+    refill(stream);
+  }
+
+  uint32_t s, value;
+  uint32_t fast = h->fast[stream->bits & 511];
+  if (fast) {
+    s = fast >> 9;
+    value = fast & 511;
+  } else {
+    uint32_t k = reverse16(stream->bits & 0xffff);
+    for (s = 10; k >= h->maxCode[s]; s++);
+    if (s >= 16) {
+      stream->error = true;
+      return 0;
+    }
+
+    uint32_t index = (k >> (16 - s)) - h->firstCode[s] + h->firstSymbol[s];
+    if (index >= 288 || h->size[index] != s) {
+      stream->error = true;
+      return 0;
+    }
+    value = h->value[index];
+  }
+
+  if (s > stream->bitCount) {
+    stream->error = true;
+    return 0;
+  }
+
+  stream->bits >>= s;
+  stream->bitCount -= s;
+  return value;
+}
+
+static bool readDynamicTables(zip_stream* stream) {
+  static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  uint8_t lengths[286 + 32] = { 0 };
+  uint8_t codeLengths[19] = { 0 };
+  zip_huffman codes;
+
+  uint32_t literalCount = getBits(stream, 5) + 257;
+  uint32_t distanceCount = getBits(stream, 5) + 1;
+  uint32_t codeCount = getBits(stream, 4) + 4;
+  if (literalCount > 286 || distanceCount > 30) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < codeCount; i++) {
+    codeLengths[order[i]] = getBits(stream, 3);
+  }
+
+  if (stream->error || !buildHuffman(&codes, codeLengths, 19)) {
+    return false;
+  }
+
+  uint32_t total = literalCount + distanceCount;
+  for (uint32_t n = 0; n < total && !stream->error;) {
+    uint32_t code = decode(stream, &codes);
+    uint32_t repeat;
+    uint8_t value = 0;
+    if (code < 16) {
+      lengths[n++] = code;
+      continue;
+    } else if (code == 16) {
+      if (n == 0) return false;
+      value = lengths[n - 1];
+      repeat = getBits(stream, 2) + 3;
+    } else if (code == 17) {
+      repeat = getBits(stream, 3) + 3;
+    } else {
+      repeat = getBits(stream, 7) + 11;
+    }
+
+    if (n + repeat > total) {
+      return false;
+    }
+
+    memset(lengths + n, value, repeat);
+    n += repeat;
+  }
+
+  return !stream->error && lengths[256] != 0 &&
+    buildHuffman(&stream->literals, lengths, literalCount) &&
+    buildHuffman(&stream->distances, lengths + literalCount, distanceCount);
+}
+
+static void readFixedTables(zip_stream* stream) {
+  uint8_t lengths[288];
+  memset(lengths, 8, 144);
+  memset(lengths + 144, 9, 112);
+  memset(lengths + 256, 7, 24);
+  memset(lengths + 280, 8, 8);
+  buildHuffman(&stream->literals, lengths, 288);
+  memset(lengths, 5, 30);
+  buildHuffman(&stream->distances, lengths, 30);
+}
+
+static void readHeader(zip_stream* stream) {
+  if (stream->final) {
+    stream->mode = MODE_DONE;
+    return;
+  }
+
+  stream->final = getBits(stream, 1);
+
+  switch (getBits(stream, 2)) {
+    case 0: {
+      getBits(stream, stream->bitCount & 7);
+      uint32_t length = getBits(stream, 16);
+      uint32_t check = getBits(stream, 16);
+      if ((length ^ 0xffff) != check) {
+        stream->error = true;
+        return;
+      }
+
+      // Stored blocks are copied straight from the source, so give back the bytes in the bit buffer
+      stream->cursor -= stream->bitCount / 8;
+      stream->bits = 0;
+      stream->bitCount = 0;
+      stream->stored = length;
+      stream->mode = MODE_STORED;
+      return;
+    }
+    case 1:
+      readFixedTables(stream);
+      stream->mode = MODE_HUFFMAN;
+      return;
+    case 2:
+      stream->error |= !readDynamicTables(stream);
+      stream->mode = MODE_HUFFMAN;
+      return;
+    default:
+      stream->error = true;
+      return;
+  }
+}
+
+// Inflates until at least want bytes are waiting in the window (or the data runs out).  A match is
+// at most 258 bytes, so the unread bytes never get close to the 32KB that matches can reach back.
+static void fill(zip_stream* stream, uint32_t want) {
+  uint8_t* window = stream->window;
+
+  while (stream->written - stream->read < want && stream->mode != MODE_DONE && !stream->error) {
+    switch (stream->mode) {
+      case MODE_HEADER:
+        readHeader(stream);
+        break;
+
+      case MODE_STORED: {
+        uint32_t n = want - (uint32_t) (stream->written - stream->read);
+        n = n < stream->stored ? n : stream->stored;
+        if (n > stream->csize - stream->cursor) {
+          stream->error = true;
+          break;
+        }
+
+        uint32_t start = stream->written & WINDOW_MASK;
+        uint32_t first = n < WINDOW_SIZE - start ? n : WINDOW_SIZE - start;
+        memcpy(window + start, stream->src + stream->cursor, first);
+        memcpy(window, stream->src + stream->cursor + first, n - first);
+        stream->cursor += n;
+        stream->written += n;
+        stream->stored -= n;
+        if (stream->stored == 0) {
+          stream->mode = MODE_HEADER;
+        }
+        break;
+      }
+
+      case MODE_HUFFMAN:
+        while (stream->written - stream->read < want) {
+          uint32_t symbol = decode(stream, &stream->literals);
+
+          if (stream->error) {
+            break;
+          } else if (symbol < 256) {
+            window[stream->written++ & WINDOW_MASK] = symbol;
+            continue;
+          } else if (symbol == 256) {
+            stream->mode = MODE_HEADER;
+            break;
+          } else if (symbol - 257 >= 29) {
+            stream->error = true;
+            break;
+          }
+
+          symbol -= 257;
+          uint32_t length = lengthBase[symbol] + getBits(stream, lengthExtra[symbol]);
+          uint32_t code = decode(stream, &stream->distances);
+          if (code >= 30) {
+            stream->error = true;
+            break;
+          }
+
+          uint32_t distance = distanceBase[code] + getBits(stream, distanceExtra[code]);
+          if (stream->error || distance > stream->written) {
+            stream->error = true;
+            break;
+          }
+
+          uint64_t from = stream->written - distance;
+          for (uint32_t i = 0; i < length; i++) {
+            window[stream->written++ & WINDOW_MASK] = window[from++ & WINDOW_MASK];
+          }
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+bool zip_stream_init(zip_stream* stream, const void* src, uint64_t csize, bool compressed) {
+  memset(stream, 0, offsetof(zip_stream, literals));
+  stream->src = src;
+  stream->csize = csize;
+  stream->compressed = compressed;
+  stream->mode = MODE_HEADER;
+
+  if (compressed && (stream->window = malloc(WINDOW_SIZE)) == NULL) {
+    return false;
+  }
+
+  return true;
+}
+
+// Returns the number of bytes read, which is less than requested at the end of the data or if the
+// data is corrupt (in which case error is set)
+size_t zip_stream_read(zip_stream* stream, void* dst, size_t bytes) {
+  uint8_t* p = dst;
+
+  if (!stream->compressed) {
+    uint64_t remaining = stream->csize - stream->cursor;
+    size_t n = bytes < remaining ? bytes : (size_t) remaining;
+    memcpy(p, stream->src + stream->cursor, n);
+    stream->cursor += n;
+    return n;
+  }
+
+  size_t total = 0;
+  while (total < bytes) {
+    if (stream->written == stream->read) {
+      size_t want = bytes - total;
+      fill(stream, want < FILL_MAX ? (uint32_t) want : FILL_MAX);
+      if (stream->written == stream->read) {
+        break;
+      }
+    }
+
+    uint32_t start = stream->read & WINDOW_MASK;
+    uint64_t available = stream->written - stream->read;
+    size_t n = bytes - total < available ? bytes - total : (size_t) available;
+    n = n < WINDOW_SIZE - start ? n : WINDOW_SIZE - start;
+    memcpy(p + total, stream->window + start, n);
+    stream->read += n;
+    total += n;
+  }
+
+  return total;
+}
+
+void zip_stream_free(zip_stream* stream) {
+  free(stream->window);
+  stream->window = NULL;
 }
@@ -4,32 +4,75 @@
 
 // Status:
 //  - Little endian only
-//  - Zip64 is not supported
+//  - Zip64 is supported
 //  - Self-extracting archives are supported
-//  - Supports store and deflate compression
-//  - No comment allowed at the end of archive (file comments are okay)
+//  - Supports store, deflate, Zstandard, and LZ4 compression
+//  - Archive comments are supported
 //  - No multi-disk archives
 //  - No encryption
 
 #pragma once
 
+// Zstandard is method 93 in the zip spec.  LZ4 doesn't have an assigned method, so archives using
+// it have to be written by a packer that knows about ZIP_LZ4 (each entry is one LZ4 frame).
+enum {
+  ZIP_STORE = 0,
+  ZIP_DEFLATE = 8,
+  ZIP_ZSTD = 93,
+  ZIP_LZ4 = 0x4c34
+};
+
 typedef struct {
   uint8_t* data;
   size_t size;
-  size_t base;
-  size_t cursor;
+  uint64_t base;
+  uint64_t cursor;
   uint64_t count;
 } zip_state;
 
 typedef struct {
   uint64_t offset;
   uint64_t size;
+  uint64_t csize;
   const char* name;
   uint16_t length;
   uint16_t mdate;
   uint16_t mtime;
 } zip_file;
 
+typedef struct {
+  uint16_t fast[512];
+  uint16_t firstCode[16];
+  uint32_t maxCode[17];
+  uint16_t firstSymbol[16];
+  uint8_t size[288];
+  uint16_t value[288];
+} zip_huffman;
+
+// Decompresses an entry a piece at a time, keeping only the 32KB deflate window around.  The
+// compressed data has to stay in memory (it's normally in the mapped archive).
+typedef struct {
+  const uint8_t* src;
+  uint64_t csize;
+  uint64_t cursor;
+  uint64_t bits;
+  uint32_t bitCount;
+  uint8_t* window;
+  uint64_t written;
+  uint64_t read;
+  uint32_t stored;
+  uint8_t mode;
+  bool final;
+  bool compressed;
+  bool error;
+  zip_huffman literals;
+  zip_huffman distances;
+} zip_stream;
+
 bool zip_open(zip_state* zip);
 bool zip_next(zip_state* zip, zip_file* info);
-void* zip_load(zip_state* zip, size_t offset, size_t* csize, bool* compressed);
+void* zip_load(zip_state* zip, uint64_t offset, uint64_t csize, uint16_t* method);
+bool zip_lz4(const void* src, uint64_t csize, void* dst, size_t size);
+bool zip_stream_init(zip_stream* stream, const void* src, uint64_t csize, bool compressed);
+size_t zip_stream_read(zip_stream* stream, void* dst, size_t bytes);
+void zip_stream_free(zip_stream* stream);
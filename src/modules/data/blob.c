@@ -1,14 +1,21 @@
 #include "data/blob.h"
+#include "core/ref.h"
 #include <stdlib.h>
 
 Blob* lovrBlobInit(Blob* blob, void* data, size_t size, const char* name) {
   blob->data = data;
   blob->size = size;
   blob->name = name;
+  blob->owner = NULL;
+  blob->destructor = NULL;
   return blob;
 }
 
 void lovrBlobDestroy(void* ref) {
   Blob* blob = ref;
-  free(blob->data);
+  if (blob->owner) {
+    _lovrRelease(blob->owner, blob->destructor);
+  } else {
+    free(blob->data);
+  }
 }
@@ -2,10 +2,14 @@
 
 #pragma once
 
+// If the data belongs to another object (like a mapped archive), the Blob holds a reference to the
+// owner instead of freeing the data, and the data should be treated as read only.
 typedef struct Blob {
   void* data;
   size_t size;
   const char* name;
+  void* owner;
+  void (*destructor)(void* owner);
 } Blob;
 
 Blob* lovrBlobInit(Blob* blob, void* data, size_t size, const char* name);
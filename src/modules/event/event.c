@@ -1,34 +1,93 @@
 #include "event/event.h"
 #include "core/arr.h"
+#include "core/atomic.h"
 #include "core/os.h"
 #include "core/ref.h"
 #include "core/util.h"
 #include <stdlib.h>
 #include <string.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/thread.h"
+#include "lib/tinycthread/tinycthread.h"
+#endif
+
+// Events go through a bounded lock-free ring (the same sequence-numbered cells as a bounded Channel)
+// so any thread can push, but only the main thread polls.  When the ring fills up, events spill
+// into a locked overflow array, unless the queue is fixed, in which case the push fails.  Once
+// something has spilled, pushes keep going to the overflow until it drains, to keep events in order.
+
+typedef struct {
+  atomic64 sequence;
+  Event event;
+} EventCell;
 
 static struct {
   bool initialized;
-  arr_t(Event) events;
-  size_t head;
+  bool fixed;
+  EventCell* cells;
+  uint64_t mask;
+  atomic64 head;
+  uint64_t tail;
+  arr_t(Event) overflow;
+  size_t overflowHead;
+  atomic64 overflowCount;
+#ifdef LOVR_ENABLE_THREAD
+  mtx_t lock;
+#endif
 } state;
 
+VariantString* lovrVariantStringCreate(const char* data, size_t length) {
+  VariantString* string = malloc(sizeof(VariantString) + length + 1);
+  lovrAssert(string, "Out of memory");
+  string->length = length;
+  memcpy(string->data, data, length);
+  string->data[length] = '\0';
+  return string;
+}
+
 void lovrVariantDestroy(Variant* variant) {
   switch (variant->type) {
     case TYPE_STRING: free(variant->value.string); return;
     case TYPE_OBJECT: _lovrRelease(variant->value.object.pointer, variant->value.object.destructor); return;
+    case TYPE_TABLE: {
+      VariantObject* objects = variant->value.table.data;
+      for (uint32_t i = 0; i < variant->value.table.objectCount; i++) {
+        _lovrRelease(objects[i].pointer, objects[i].destructor);
+      }
+      free(variant->value.table.data);
+      return;
+    }
     default: return;
   }
 }
 
-bool lovrEventInit() {
+// The capacity is rounded up to a power of two
+bool lovrEventInit(uint32_t capacity, bool fixed) {
   if (state.initialized) return false;
-  arr_init(&state.events);
+  uint64_t size = 2;
+  while (size < capacity) size <<= 1;
+  state.cells = malloc(size * sizeof(EventCell));
+  lovrAssert(state.cells, "Out of memory");
+  for (uint64_t i = 0; i < size; i++) {
+    state.cells[i].sequence = i;
+  }
+  state.mask = size - 1;
+  state.fixed = fixed;
+  arr_init(&state.overflow);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_init(&state.lock, mtx_plain);
+#endif
   return state.initialized = true;
 }
 
 void lovrEventDestroy() {
   if (!state.initialized) return;
-  arr_free(&state.events);
+  lovrEventClear();
+  free(state.cells);
+  arr_free(&state.overflow);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_destroy(&state.lock);
+#endif
   memset(&state, 0, sizeof(state));
 }
 
@@ -36,27 +95,124 @@ void lovrEventPump() {
   lovrPlatformPollEvents();
 }
 
-void lovrEventPush(Event event) {
+static bool pushRing(Event* event) {
+  EventCell* cell;
+  uint64_t position = atomic_load64(&state.head);
+  for (;;) {
+    cell = &state.cells[position & state.mask];
+    int64_t difference = (int64_t) (atomic_load64(&cell->sequence) - position);
+    if (difference == 0) {
+      if (atomic_cas64(&state.head, &position, position + 1)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = atomic_load64(&state.head);
+    }
+  }
+
+  cell->event = *event;
+  atomic_store64(&cell->sequence, position + 1);
+  return true;
+}
+
+static bool popRing(Event* event) {
+  EventCell* cell = &state.cells[state.tail & state.mask];
+  if (atomic_load64(&cell->sequence) != state.tail + 1) {
+    return false;
+  }
+
+  *event = cell->event;
+  atomic_store64(&cell->sequence, state.tail + state.mask + 1);
+  state.tail++;
+  return true;
+}
+
+// Releases what a queued event holds on to, for events that get dropped instead of polled
+static void destroyEvent(Event* event) {
+  switch (event->type) {
+#ifdef LOVR_ENABLE_THREAD
+    case EVENT_THREAD_ERROR:
+      lovrRelease(Thread, event->data.thread.thread);
+      free(event->data.thread.error);
+      break;
+#endif
+    case EVENT_CUSTOM:
+      for (uint32_t i = 0; i < event->data.custom.count; i++) {
+        lovrVariantDestroy(&event->data.custom.data[i]);
+      }
+      break;
+    default: break;
+  }
+}
+
+// Safe to call from any thread.  Returns false if the queue is fixed and full, in which case the
+// caller still owns anything the event references.  Thread errors are copied, since the Thread's
+// error gets freed if it's restarted before the event is polled.
+bool lovrEventPush(Event event) {
 #ifdef LOVR_ENABLE_THREAD
   if (event.type == EVENT_THREAD_ERROR) {
+    const char* error = event.data.thread.error;
+    event.data.thread.error = error ? malloc(strlen(error) + 1) : NULL;
+    if (event.data.thread.error) strcpy(event.data.thread.error, error);
     lovrRetain(event.data.thread.thread);
   }
 #endif
 
-  arr_push(&state.events, event);
+  if (atomic_load64(&state.overflowCount) == 0 && pushRing(&event)) {
+    return true;
+  }
+
+  if (state.fixed) {
+#ifdef LOVR_ENABLE_THREAD
+    if (event.type == EVENT_THREAD_ERROR) {
+      lovrRelease(Thread, event.data.thread.thread);
+      free(event.data.thread.error);
+    }
+#endif
+    return false;
+  }
+
+#ifdef LOVR_ENABLE_THREAD
+  mtx_lock(&state.lock);
+#endif
+  arr_push(&state.overflow, event);
+  atomic_add64(&state.overflowCount, 1);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_unlock(&state.lock);
+#endif
+  return true;
 }
 
+// Only the main thread polls
 bool lovrEventPoll(Event* event) {
-  if (state.head == state.events.length) {
-    state.head = state.events.length = 0;
+  if (popRing(event)) {
+    return true;
+  }
+
+  if (atomic_load64(&state.overflowCount) == 0) {
     return false;
   }
 
-  *event = state.events.data[state.head++];
+#ifdef LOVR_ENABLE_THREAD
+  mtx_lock(&state.lock);
+#endif
+  *event = state.overflow.data[state.overflowHead++];
+  if (state.overflowHead == state.overflow.length) {
+    state.overflowHead = state.overflow.length = 0;
+  }
+  atomic_add64(&state.overflowCount, -1);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_unlock(&state.lock);
+#endif
   return true;
 }
 
+// Drops every queued event, releasing anything they reference
 void lovrEventClear() {
-  arr_clear(&state.events);
-  state.head = 0;
+  Event event;
+  while (lovrEventPoll(&event)) {
+    destroyEvent(&event);
+  }
 }
@@ -1,9 +1,11 @@
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #pragma once
 
 #define MAX_EVENT_NAME_LENGTH 32
+#define MAX_EVENT_CAPACITY (1 << 24)
 
 struct Thread;
 
@@ -21,18 +23,37 @@ typedef enum {
   TYPE_BOOLEAN,
   TYPE_NUMBER,
   TYPE_STRING,
-  TYPE_OBJECT
+  TYPE_OBJECT,
+  TYPE_TABLE
 } VariantType;
 
+// Strings are copied along with their length, so they can contain NUL bytes.  Every Variant owns its
+// own copy: to hand one large payload to several receivers, send a Blob, which is shared instead.
+typedef struct {
+  size_t length;
+  char data[];
+} VariantString;
+
+typedef struct {
+  void* pointer;
+  const char* type;
+  void (*destructor)(void*);
+} VariantObject;
+
+// Tables are serialized into a single allocation: the objects they reference (which are retained)
+// come first, followed by the encoded contents.
+typedef struct {
+  void* data;
+  size_t size;
+  uint32_t objectCount;
+} VariantTable;
+
 typedef union {
   bool boolean;
   double number;
-  char* string;
-  struct {
-    void* pointer;
-    const char* type;
-    void (*destructor)(void*);
-  } object;
+  VariantString* string;
+  VariantObject object;
+  VariantTable table;
 } VariantValue;
 
 typedef struct Variant {
@@ -72,11 +93,12 @@ typedef struct {
   EventData data;
 } Event;
 
+VariantString* lovrVariantStringCreate(const char* data, size_t length);
 void lovrVariantDestroy(Variant* variant);
 
-bool lovrEventInit(void);
+bool lovrEventInit(uint32_t capacity, bool fixed);
 void lovrEventDestroy(void);
 void lovrEventPump(void);
-void lovrEventPush(Event event);
+bool lovrEventPush(Event event);
 bool lovrEventPoll(Event* event);
 void lovrEventClear(void);
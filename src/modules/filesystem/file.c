@@ -4,13 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Currently only read operations are supported by File and all files are read into memory fully on open
-
-typedef struct {
-  uint8_t* data;
-  size_t offset;
-  size_t size;
-} FileInner;
+// Currently only read operations are supported by File.  Files are read as they're used, and files
+// compressed in zip archives are inflated as they're read.
 
 File* lovrFileInit(File* file ,const char* path) {
   file->path = path;
@@ -33,35 +28,22 @@ bool lovrFileOpen(File* file, FileMode mode) {
   if (mode == OPEN_WRITE || mode == OPEN_APPEND)
     return false;
 
-  FileInner *fileInner = malloc(sizeof(FileInner));
-  fileInner->offset = 0;
-  fileInner->data = lovrFilesystemRead(file->path, -1, &fileInner->size);
-  file->handle = fileInner;
-
-  if (!fileInner->data) {
-    fileInner->size = 0;
-    return false;
-  }
-
-  return true;
+  file->handle = lovrFilesystemOpenReader(file->path);
+  return file->handle != NULL;
 }
 
 void lovrFileClose(File* file) {
   lovrAssert(file->handle, "File must be open to close it");
-  FileInner *fileInner = (FileInner *)file->handle;
-  free(fileInner->data);
-  free(file->handle);
+  lovrFileReaderClose(file->handle);
   file->handle = NULL;
 }
 
 size_t lovrFileRead(File* file, void* data, size_t bytes) {
   lovrAssert(file->handle && file->mode == OPEN_READ, "File must be open for reading");
-  FileInner *fileInner = (FileInner *)file->handle;
-  if (fileInner->offset + bytes > fileInner->size)
+  FileReader* reader = file->handle;
+  if (lovrFileReaderTell(reader) + bytes > lovrFileReaderGetSize(reader))
     return 0;
-  memcpy(data, fileInner->data + fileInner->offset, bytes);
-  fileInner->offset += bytes;
-  return bytes;
+  return lovrFileReaderRead(reader, data, bytes);
 }
 
 size_t lovrFileWrite(File* file, const void* data, size_t bytes) {
@@ -70,21 +52,17 @@ size_t lovrFileWrite(File* file, const void* data, size_t bytes) {
 
 size_t lovrFileGetSize(File* file) {
   lovrAssert(file->handle, "File must be open to get its size");
-  FileInner *fileInner = (FileInner *)file->handle;
-  return fileInner->size;
+  return lovrFileReaderGetSize(file->handle);
 }
 
 bool lovrFileSeek(File* file, size_t position) {
   lovrAssert(file->handle, "File must be open to seek");
-  FileInner *fileInner = (FileInner *)file->handle;
-  if (position >= fileInner->size) // FIXME: Should seeking to fileInner->size exactly be allowed?
+  if (position >= lovrFileReaderGetSize(file->handle)) // FIXME: Should seeking to the size exactly be allowed?
     return false;
-  fileInner->offset = position;
-  return true;
+  return lovrFileReaderSeek(file->handle, position);
 }
 
 size_t lovrFileTell(File* file) {
   lovrAssert(file->handle, "File must be open to tell");
-  FileInner *fileInner = (FileInner *)file->handle;
-  return fileInner->offset;
+  return lovrFileReaderTell(file->handle);
 }
@@ -3,11 +3,18 @@
 #include "core/fs.h"
 #include "core/hash.h"
 #include "core/map.h"
+#include "core/ref.h"
+#include "core/util.h"
 #include "core/zip.h"
 #include "lib/stb/stb_image.h"
+#include "lib/zstd/zstd.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#ifdef LOVR_ENABLE_THREAD
+#include "thread/job.h"
+#include "lib/tinycthread/tinycthread.h"
+#endif
 
 #define FOREACH_ARCHIVE(a) for (Archive* a = state.archives.data; a != state.archives.data + state.archives.length; a++)
 
@@ -31,16 +38,57 @@ typedef struct {
   uint32_t nextSibling;
   size_t filename;
   uint64_t offset;
+  uint64_t csize;
   uint16_t mdate;
   uint16_t mtime;
   FileInfo info;
 } zip_node;
 
+// Mapped archives (and cached file contents) are refcounted, so Blobs and readers that point into
+// them keep them alive
+struct FileMapping {
+  void* data;
+  size_t size;
+  bool mapped;
+};
+
+// Inflated zip entries, most recently used first
+typedef struct CacheEntry {
+  struct CacheEntry* prev;
+  struct CacheEntry* next;
+  FileMapping* archive;
+  FileMapping* contents;
+  uint64_t key;
+} CacheEntry;
+
+// A compressed zip entry that's going to be decompressed into the cache by lovrFilesystemPrefetch
+typedef struct {
+  FileMapping* archive;
+  const zip_node* node;
+  const void* src;
+  uint32_t index;
+  uint16_t method;
+  bool cached;
+} PrefetchEntry;
+
+// Readers either read a file directly or go through a zip_stream on a mapped archive
+struct FileReader {
+  uint64_t size;
+  uint64_t offset;
+  bool native;
+  fs_handle file;
+  FileMapping* mapping;
+  zip_stream stream;
+};
+
 typedef struct Archive {
   bool (*stat)(struct Archive* archive, const char* path, FileInfo* info);
   void (*list)(struct Archive* archive, const char* path, fs_list_cb callback, void* context);
   bool (*read)(struct Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data);
+  bool (*map)(struct Archive* archive, const char* path, size_t* size, void** data, FileMapping** mapping);
+  bool (*open)(struct Archive* archive, const char* path, FileReader* reader);
   bool (*close)(struct Archive* archive);
+  FileMapping* mapping;
   zip_state zip;
   strpool strings;
   arr_t(zip_node) nodes;
@@ -60,8 +108,25 @@ static struct {
   char requirePath[2][1024];
   char* identity;
   bool fused;
+  struct {
+    map_t lookup;
+    CacheEntry* head;
+    CacheEntry* tail;
+    FileCacheStats stats;
+#ifdef LOVR_ENABLE_THREAD
+    mtx_t lock;
+#endif
+  } cache;
 } state;
 
+#ifdef LOVR_ENABLE_THREAD
+#define lockCache() mtx_lock(&state.cache.lock)
+#define unlockCache() mtx_unlock(&state.cache.lock)
+#else
+#define lockCache()
+#define unlockCache()
+#endif
+
 static bool valid(const char* path) {
   if (path[0] == '.' && (path[1] == '\0' || path[1] == '.')) {
     return false;
@@ -111,6 +176,10 @@ bool lovrFilesystemInit(const char* argExe, const char* argGame, const char* arg
 
   arr_init(&state.archives);
   arr_reserve(&state.archives, 2);
+  map_init(&state.cache.lookup, 0);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_init(&state.cache.lock, mtx_plain);
+#endif
 
   lovrFilesystemSetRequirePath("?.lua;?/init.lua;lua_modules/?.lua;lua_modules/?/init.lua;deps/?.lua;deps/?/init.lua");
   lovrFilesystemSetCRequirePath("??;lua_modules/??;deps/??");
@@ -142,6 +211,11 @@ void lovrFilesystemDestroy() {
     archive->close(archive);
   }
   arr_free(&state.archives);
+  lovrFilesystemSetCacheBudget(0);
+  map_free(&state.cache.lookup);
+#ifdef LOVR_ENABLE_THREAD
+  mtx_destroy(&state.cache.lock);
+#endif
   memset(&state, 0, sizeof(state));
 }
 
@@ -157,6 +231,8 @@ bool lovrFilesystemIsFused() {
 
 static bool dir_init(Archive* archive, const char* path, const char* mountpoint, const char* root);
 static bool zip_init(Archive* archive, const char* path, const char* mountpoint, const char* root);
+static zip_node* zip_lookup(Archive* archive, const char* path);
+static void* zip_decompress(const zip_node* node, uint16_t method, const void* src, size_t size);
 
 bool lovrFilesystemMount(const char* path, const char* mountpoint, bool append, const char* root) {
   FOREACH_ARCHIVE(archive) {
@@ -256,6 +332,135 @@ void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead) {
   return NULL;
 }
 
+// Files stored uncompressed in a mounted zip can be used without reading them.  This returns a
+// pointer into the archive and a reference to its mapping, which must be released when finished.
+// Compressed files in zips work the same way when the cache is on, sharing the cached contents.
+// Everything else returns NULL and needs to be read.  The data is read only: the archive is mapped
+// without write access, and a write to cached contents would change what every later read of the
+// file returns.  Anything that might modify the data (like a Blob given to Lua) has to read instead.
+void* lovrFilesystemMap(const char* path, size_t* size, FileMapping** mapping) {
+  if (valid(path)) {
+    void* data;
+    FOREACH_ARCHIVE(archive) {
+      if (archive->map(archive, path, size, &data, mapping)) {
+        return data;
+      }
+    }
+  }
+  return NULL;
+}
+
+void lovrFileMappingDestroy(void* ref) {
+  FileMapping* mapping = ref;
+  if (mapping->mapped) {
+    fs_unmap(mapping->data, mapping->size);
+  } else {
+    free(mapping->data);
+  }
+}
+
+// Readers read files a piece at a time.  Deflated files in zips are inflated as they're read,
+// without ever holding the whole file in memory.  Zstandard and LZ4 files are decompressed up front.
+FileReader* lovrFilesystemOpenReader(const char* path) {
+  if (valid(path)) {
+    FOREACH_ARCHIVE(archive) {
+      FileReader* reader = calloc(1, sizeof(FileReader));
+      lovrAssert(reader, "Out of memory");
+      if (archive->open(archive, path, reader)) {
+        if (reader->native || reader->mapping) {
+          return reader;
+        }
+        free(reader);
+        return NULL;
+      }
+      free(reader);
+    }
+  }
+  return NULL;
+}
+
+void lovrFileReaderClose(FileReader* reader) {
+  if (reader->native) {
+    fs_close(reader->file);
+  } else {
+    zip_stream_free(&reader->stream);
+    lovrRelease(FileMapping, reader->mapping);
+  }
+  free(reader);
+}
+
+size_t lovrFileReaderRead(FileReader* reader, void* data, size_t bytes) {
+  if (bytes > reader->size - reader->offset) {
+    bytes = reader->size - reader->offset;
+  }
+
+  size_t total = 0;
+  if (reader->native) {
+    while (total < bytes) {
+      size_t n = bytes - total;
+      if (!fs_read(reader->file, (char*) data + total, &n) || n == 0) {
+        break;
+      }
+      total += n;
+    }
+  } else {
+    total = zip_stream_read(&reader->stream, data, bytes);
+  }
+
+  reader->offset += total;
+  return total;
+}
+
+// Seeking backwards in a compressed file starts inflating again from the beginning
+bool lovrFileReaderSeek(FileReader* reader, uint64_t position) {
+  if (position > reader->size) {
+    return false;
+  }
+
+  if (reader->native) {
+    if (!fs_seek(reader->file, position)) {
+      return false;
+    }
+    reader->offset = position;
+    return true;
+  }
+
+  zip_stream* stream = &reader->stream;
+
+  if (!stream->compressed) {
+    stream->cursor = position;
+    reader->offset = position;
+    return true;
+  }
+
+  if (position < reader->offset) {
+    zip_stream_free(stream);
+    if (!zip_stream_init(stream, stream->src, stream->csize, true)) {
+      return false;
+    }
+    reader->offset = 0;
+  }
+
+  char buffer[4096];
+  while (reader->offset < position) {
+    uint64_t remaining = position - reader->offset;
+    size_t n = remaining < sizeof(buffer) ? (size_t) remaining : sizeof(buffer);
+    if (lovrFileReaderRead(reader, buffer, n) != n) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint64_t lovrFileReaderTell(FileReader* reader) {
+  return reader->offset;
+}
+
+uint64_t lovrFileReaderGetSize(FileReader* reader) {
+  return reader->size;
+}
+
 void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* context, const char* path), void* context) {
   if (valid(path)) {
     FOREACH_ARCHIVE(archive) {
@@ -264,6 +469,193 @@ void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* co
   }
 }
 
+// Cache
+
+static void cacheUnlink(CacheEntry* entry) {
+  if (entry->prev) entry->prev->next = entry->next;
+  else state.cache.head = entry->next;
+  if (entry->next) entry->next->prev = entry->prev;
+  else state.cache.tail = entry->prev;
+  entry->prev = entry->next = NULL;
+}
+
+static void cachePushFront(CacheEntry* entry) {
+  entry->next = state.cache.head;
+  entry->prev = NULL;
+  if (state.cache.head) state.cache.head->prev = entry;
+  else state.cache.tail = entry;
+  state.cache.head = entry;
+}
+
+static void cacheEvict(CacheEntry* entry) {
+  cacheUnlink(entry);
+  map_remove(&state.cache.lookup, entry->key);
+  state.cache.stats.size -= entry->contents->size;
+  state.cache.stats.count--;
+  lovrRelease(FileMapping, entry->contents);
+  free(entry);
+}
+
+static uint64_t cacheKey(FileMapping* archive, uint32_t index) {
+  struct { FileMapping* archive; uint32_t index; } key;
+  memset(&key, 0, sizeof(key));
+  key.archive = archive;
+  key.index = index;
+  return hash64(&key, sizeof(key));
+}
+
+// Returns the contents with a new reference, or NULL
+static FileMapping* cacheGet(FileMapping* archive, uint32_t index) {
+  FileMapping* contents = NULL;
+  lockCache();
+  uint64_t value = map_get(&state.cache.lookup, cacheKey(archive, index));
+  if (value != MAP_NIL) {
+    CacheEntry* entry = (CacheEntry*) (uintptr_t) value;
+    cacheUnlink(entry);
+    cachePushFront(entry);
+    contents = entry->contents;
+    lovrRetain(contents);
+    state.cache.stats.hits++;
+    state.cache.stats.bytesSaved += contents->size;
+  } else {
+    state.cache.stats.misses++;
+  }
+  unlockCache();
+  return contents;
+}
+
+static void cachePut(FileMapping* archive, uint32_t index, FileMapping* contents) {
+  uint64_t key = cacheKey(archive, index);
+  lockCache();
+  if (contents->size <= state.cache.stats.budget && map_get(&state.cache.lookup, key) == MAP_NIL) {
+    CacheEntry* entry = malloc(sizeof(CacheEntry));
+    lovrAssert(entry, "Out of memory");
+    entry->archive = archive;
+    entry->contents = contents;
+    entry->key = key;
+    lovrRetain(contents);
+    cachePushFront(entry);
+    map_set(&state.cache.lookup, key, (uint64_t) (uintptr_t) entry);
+    state.cache.stats.size += contents->size;
+    state.cache.stats.count++;
+    while (state.cache.stats.size > state.cache.stats.budget) {
+      cacheEvict(state.cache.tail);
+    }
+  }
+  unlockCache();
+}
+
+// Called when an archive is unmounted, since a new archive could end up with the same address
+static void cachePurge(FileMapping* archive) {
+  lockCache();
+  CacheEntry* entry = state.cache.head;
+  while (entry) {
+    CacheEntry* next = entry->next;
+    if (entry->archive == archive) {
+      cacheEvict(entry);
+    }
+    entry = next;
+  }
+  unlockCache();
+}
+
+// The cache keeps inflated zip entries around so files that are read over and over (like modules
+// that get required again on restart) aren't inflated every time.  It's off with a budget of zero.
+// Cached contents are shared with Blobs, so evicting an entry doesn't free anything still in use.
+void lovrFilesystemSetCacheBudget(size_t budget) {
+  lockCache();
+  state.cache.stats.budget = budget;
+  while (state.cache.stats.size > budget) {
+    cacheEvict(state.cache.tail);
+  }
+  unlockCache();
+}
+
+void lovrFilesystemGetCacheStats(FileCacheStats* stats) {
+  lockCache();
+  *stats = state.cache.stats;
+  unlockCache();
+}
+
+static bool cacheHas(FileMapping* archive, uint32_t index) {
+  lockCache();
+  bool found = map_get(&state.cache.lookup, cacheKey(archive, index)) != MAP_NIL;
+  unlockCache();
+  return found;
+}
+
+static void prefetchRange(void* context, uint32_t start, uint32_t end) {
+  PrefetchEntry* entries = context;
+  for (uint32_t i = start; i < end; i++) {
+    PrefetchEntry* entry = &entries[i];
+    void* data = zip_decompress(entry->node, entry->method, entry->src, entry->node->info.size);
+    if (data) {
+      FileMapping* contents = lovrAlloc(FileMapping);
+      contents->data = data;
+      contents->size = entry->node->info.size;
+      cachePut(entry->archive, entry->index, contents);
+      lovrRelease(FileMapping, contents);
+      entry->cached = true;
+    }
+  }
+}
+
+// Decompresses zip entries into the cache ahead of time, on the job workers if there are any, so
+// reading them later is just a copy.  Paths that resolve to plain files, stored entries, or entries
+// that are already cached are skipped.  Entries past the cache budget are skipped too, since they
+// would only evict the ones before them.  Returns the number of entries that were decompressed.
+uint32_t lovrFilesystemPrefetch(const char** paths, uint32_t count) {
+  arr_t(PrefetchEntry) entries;
+  arr_init(&entries);
+  map_t seen;
+  map_init(&seen, count);
+  uint64_t budget = state.cache.stats.budget;
+  uint64_t total = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (!valid(paths[i])) continue;
+
+    // Only zip archives have a mapping, and only the first archive with the path gets read
+    FileInfo info;
+    Archive* archive = archiveStat(paths[i], &info);
+    if (!archive || !archive->mapping || info.type != FILE_REGULAR) continue;
+
+    const zip_node* node = zip_lookup(archive, paths[i]);
+    uint32_t index = (uint32_t) (node - archive->nodes.data);
+    uint64_t key = cacheKey(archive->mapping, index);
+    if (map_get(&seen, key) != MAP_NIL || cacheHas(archive->mapping, index)) continue;
+    map_set(&seen, key, index);
+
+    uint16_t method;
+    const void* src = zip_load(&archive->zip, node->offset, node->csize, &method);
+    if (!src || method == ZIP_STORE || total + node->info.size > budget) continue;
+    total += node->info.size;
+
+    arr_push(&entries, ((PrefetchEntry) {
+      .archive = archive->mapping,
+      .node = node,
+      .src = src,
+      .index = index,
+      .method = method
+    }));
+  }
+
+#ifdef LOVR_ENABLE_THREAD
+  lovrJobParallelFor((uint32_t) entries.length, 1, prefetchRange, entries.data);
+#else
+  prefetchRange(entries.data, 0, (uint32_t) entries.length);
+#endif
+
+  uint32_t inflated = 0;
+  for (size_t i = 0; i < entries.length; i++) {
+    inflated += entries.data[i].cached;
+  }
+
+  arr_free(&entries);
+  map_free(&seen);
+  return inflated;
+}
+
 // Writing
 
 const char* lovrFilesystemGetIdentity() {
@@ -464,6 +856,28 @@ static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* b
   return true;
 }
 
+static bool dir_map(Archive* archive, const char* path, size_t* size, void** data, FileMapping** mapping) {
+  char resolved[LOVR_PATH_MAX];
+  *data = NULL;
+  return dir_resolve(resolved, archive, path) && fs_stat(resolved, NULL);
+}
+
+static bool dir_open(Archive* archive, const char* path, FileReader* reader) {
+  char resolved[LOVR_PATH_MAX];
+  FileInfo info;
+
+  if (!dir_resolve(resolved, archive, path) || !fs_stat(resolved, &info)) {
+    return false;
+  }
+
+  if (info.type == FILE_REGULAR && fs_open(resolved, OPEN_READ, &reader->file)) {
+    reader->native = true;
+    reader->size = info.size;
+  }
+
+  return true;
+}
+
 static bool dir_close(Archive* archive) {
   arr_free(&archive->strings);
   return true;
@@ -478,7 +892,10 @@ static bool dir_init(Archive* archive, const char* path, const char* mountpoint,
   archive->stat = dir_stat;
   archive->list = dir_list;
   archive->read = dir_read;
+  archive->map = dir_map;
+  archive->open = dir_open;
   archive->close = dir_close;
+  archive->mapping = NULL;
   return true;
 }
 
@@ -529,39 +946,197 @@ static void zip_list(Archive* archive, const char* path, fs_list_cb callback, vo
   }
 }
 
+// Zstandard frames can be decoded in one call when the whole entry is wanted, partial reads stream
+// until the buffer is full
+static bool zip_zstd(const void* src, uint64_t csize, void* dst, size_t size, bool whole) {
+  if (whole) {
+    return ZSTD_decompress(dst, size, src, csize) == size;
+  }
+
+  ZSTD_DStream* stream = ZSTD_createDStream();
+  if (!stream) {
+    return false;
+  }
+
+  ZSTD_inBuffer input = { src, csize, 0 };
+  ZSTD_outBuffer output = { dst, size, 0 };
+  while (output.pos < size) {
+    size_t written = output.pos;
+    size_t consumed = input.pos;
+    size_t status = ZSTD_decompressStream(stream, &output, &input);
+    if (ZSTD_isError(status) || (output.pos == written && input.pos == consumed)) {
+      break;
+    }
+  }
+
+  ZSTD_freeDStream(stream);
+  return output.pos == size;
+}
+
+// Decompresses the first size bytes of an entry into a new buffer
+static void* zip_decompress(const zip_node* node, uint16_t method, const void* src, size_t size) {
+  void* dst = malloc(size);
+  if (!dst) {
+    return NULL;
+  }
+
+  bool whole = size == node->info.size;
+  bool success = false;
+
+  switch (method) {
+    case ZIP_DEFLATE:
+      // Partial reads (and files too big for stb_image) only inflate as much as they need
+      if (whole && size <= INT32_MAX && node->csize <= INT32_MAX) {
+        success = stbi_zlib_decode_noheader_buffer(dst, (int) size, src, (int) node->csize) >= 0;
+      } else {
+        zip_stream stream;
+        success = zip_stream_init(&stream, src, node->csize, true) && zip_stream_read(&stream, dst, size) == size;
+        zip_stream_free(&stream);
+      }
+      break;
+    case ZIP_ZSTD: success = zip_zstd(src, node->csize, dst, size, whole); break;
+    case ZIP_LZ4: success = zip_lz4(src, node->csize, dst, size); break;
+    default: break;
+  }
+
+  if (!success) {
+    free(dst);
+    return NULL;
+  }
+
+  return dst;
+}
+
+// Returns the decompressed contents of an entry with a new reference, from the cache if it's on
+static FileMapping* zip_cached(Archive* archive, const zip_node* node, uint16_t method, const void* src) {
+  uint32_t index = (uint32_t) (node - archive->nodes.data);
+  bool cache = state.cache.stats.budget > 0;
+  FileMapping* contents = cache ? cacheGet(archive->mapping, index) : NULL;
+
+  if (!contents) {
+    void* data = zip_decompress(node, method, src, node->info.size);
+    if (!data) {
+      return NULL;
+    }
+
+    contents = lovrAlloc(FileMapping);
+    contents->data = data;
+    contents->size = node->info.size;
+    if (cache) {
+      cachePut(archive->mapping, index, contents);
+    }
+  }
+
+  return contents;
+}
+
 static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** dst) {
   const zip_node* node = zip_lookup(archive, path);
   if (!node) return false;
 
   // Directories can't be read (but still return true because the file was present in the archive)
-  if (node->info.type == FILE_DIRECTORY) {
+  if (node->info.type == FILE_DIRECTORY || node->info.size > SIZE_MAX) {
     *dst = NULL;
     return true;
   }
 
   size_t dstSize = node->info.size;
-  size_t srcSize;
-  bool compressed;
+  uint16_t method;
   const void* src;
 
-  if ((src = zip_load(&archive->zip, node->offset, &srcSize, &compressed)) == NULL) {
+  if ((src = zip_load(&archive->zip, node->offset, node->csize, &method)) == NULL) {
     *dst = NULL;
     return true;
   }
 
-  if ((*dst = malloc(dstSize)) == NULL) {
+  size_t size = (bytes == (size_t) -1 || bytes > dstSize) ? dstSize : bytes;
+
+  if (method != ZIP_STORE && size == dstSize && state.cache.stats.budget > 0) {
+    FileMapping* contents = zip_cached(archive, node, method, src);
+    *dst = contents ? malloc(size) : NULL;
+    if (*dst) {
+      memcpy(*dst, contents->data, size);
+      *bytesRead = size;
+    }
+    lovrRelease(FileMapping, contents);
     return true;
   }
 
-  *bytesRead = (bytes == (size_t) -1 || bytes > dstSize) ? (uint32_t) dstSize : bytes;
+  if (method != ZIP_STORE) {
+    *dst = zip_decompress(node, method, src, size);
+  } else if ((*dst = malloc(size)) != NULL) {
+    memcpy(*dst, src, size);
+  }
+
+  if (*dst) {
+    *bytesRead = size;
+  }
+
+  return true;
+}
+
+static bool zip_map(Archive* archive, const char* path, size_t* size, void** data, FileMapping** mapping) {
+  const zip_node* node = zip_lookup(archive, path);
+  if (!node) return false;
+
+  uint16_t method;
+  *data = NULL;
 
-  if (compressed) {
-    if (stbi_zlib_decode_noheader_buffer(*dst, (int) dstSize, src, (int) srcSize) < 0) {
-      free(*dst);
-      *dst = NULL;
+  if (node->info.type == FILE_DIRECTORY || node->info.size > SIZE_MAX) {
+    return true;
+  }
+
+  void* src = zip_load(&archive->zip, node->offset, node->csize, &method);
+
+  if (src && method == ZIP_STORE) {
+    lovrRetain(archive->mapping);
+    *mapping = archive->mapping;
+    *data = src;
+    *size = node->info.size;
+  } else if (src && state.cache.stats.budget > 0) {
+    // Shared with the cache, which is why mapped data can't be written to
+    FileMapping* contents = zip_cached(archive, node, method, src);
+    if (contents) {
+      *mapping = contents;
+      *data = contents->data;
+      *size = contents->size;
     }
-  } else {
-    memcpy(*dst, src, *bytesRead);
+  }
+
+  return true;
+}
+
+static bool zip_openfile(Archive* archive, const char* path, FileReader* reader) {
+  const zip_node* node = zip_lookup(archive, path);
+  if (!node) return false;
+
+  uint16_t method;
+  const void* src;
+
+  if (node->info.type == FILE_DIRECTORY) {
+    return true;
+  }
+
+  if ((src = zip_load(&archive->zip, node->offset, node->csize, &method)) == NULL) {
+    return true;
+  }
+
+  // Zstandard and LZ4 don't stream, so the reader reads from the decompressed contents instead
+  if (method == ZIP_ZSTD || method == ZIP_LZ4) {
+    FileMapping* contents = node->info.size <= SIZE_MAX ? zip_cached(archive, node, method, src) : NULL;
+    if (contents && zip_stream_init(&reader->stream, contents->data, contents->size, false)) {
+      reader->mapping = contents;
+      reader->size = node->info.size;
+    } else {
+      lovrRelease(FileMapping, contents);
+    }
+    return true;
+  }
+
+  if (zip_stream_init(&reader->stream, src, node->csize, method == ZIP_DEFLATE)) {
+    lovrRetain(archive->mapping);
+    reader->mapping = archive->mapping;
+    reader->size = node->info.size;
   }
 
   return true;
@@ -571,16 +1146,28 @@ static bool zip_close(Archive* archive) {
   arr_free(&archive->nodes);
   map_free(&archive->lookup);
   arr_free(&archive->strings);
-  return fs_unmap(archive->zip.data, archive->zip.size);
+  if (archive->mapping) {
+    cachePurge(archive->mapping);
+  }
+  lovrRelease(FileMapping, archive->mapping);
+  return true;
 }
 
 static bool zip_init(Archive* archive, const char* filename, const char* mountpoint, const char* root) {
   char path[LOVR_PATH_MAX];
   memset(&archive->lookup, 0, sizeof(archive->lookup));
   arr_init(&archive->nodes);
+  archive->mapping = NULL;
 
   // mmap the zip file, try to parse it, and figure out how many files there are
   archive->zip.data = fs_map(filename, &archive->zip.size);
+  if (archive->zip.data) {
+    archive->mapping = lovrAlloc(FileMapping);
+    archive->mapping->data = archive->zip.data;
+    archive->mapping->size = archive->zip.size;
+    archive->mapping->mapped = true;
+  }
+
   if (!archive->zip.data || !zip_open(&archive->zip) || archive->zip.count > UINT32_MAX) {
     zip_close(archive);
     return false;
@@ -622,6 +1209,7 @@ static bool zip_init(Archive* archive, const char* filename, const char* mountpo
       .nextSibling = ~0u,
       .filename = (size_t) -1,
       .offset = info.offset,
+      .csize = info.csize,
       .mdate = info.mdate,
       .mtime = info.mtime,
       .info.size = info.size,
@@ -683,6 +1271,8 @@ static bool zip_init(Archive* archive, const char* filename, const char* mountpo
   archive->stat = zip_stat;
   archive->list = zip_list;
   archive->read = zip_read;
+  archive->map = zip_map;
+  archive->open = zip_openfile;
   archive->close = zip_close;
   return true;
 }
@@ -12,6 +12,18 @@
 #define LOVR_PATH_SEP '/'
 #endif
 
+typedef struct FileMapping FileMapping;
+typedef struct FileReader FileReader;
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t bytesSaved;
+  size_t size;
+  size_t budget;
+  uint32_t count;
+} FileCacheStats;
+
 bool lovrFilesystemInit(const char* argExe, const char* argGame, const char* argRoot);
 void lovrFilesystemDestroy(void);
 const char* lovrFilesystemGetSource(void);
@@ -24,6 +36,17 @@ bool lovrFilesystemIsDirectory(const char* path);
 uint64_t lovrFilesystemGetSize(const char* path);
 uint64_t lovrFilesystemGetLastModified(const char* path);
 void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead);
+void* lovrFilesystemMap(const char* path, size_t* size, FileMapping** mapping);
+void lovrFileMappingDestroy(void* ref);
+FileReader* lovrFilesystemOpenReader(const char* path);
+void lovrFileReaderClose(FileReader* reader);
+size_t lovrFileReaderRead(FileReader* reader, void* data, size_t bytes);
+bool lovrFileReaderSeek(FileReader* reader, uint64_t position);
+uint64_t lovrFileReaderTell(FileReader* reader);
+uint64_t lovrFileReaderGetSize(FileReader* reader);
+void lovrFilesystemSetCacheBudget(size_t budget);
+void lovrFilesystemGetCacheStats(FileCacheStats* stats);
+uint32_t lovrFilesystemPrefetch(const char** paths, uint32_t count);
 void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* context, const char* path), void* context);
 const char* lovrFilesystemGetIdentity(void);
 bool lovrFilesystemSetIdentity(const char* identity);
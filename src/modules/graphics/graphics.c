@@ -8,7 +8,10 @@
 #include "data/rasterizer.h"
 #include "event/event.h"
 #include "math/math.h"
+#include "core/arr.h"
+#include "core/hash.h"
 #include "core/maf.h"
+#include "core/map.h"
 #include "core/ref.h"
 #include "core/util.h"
 #include <stdlib.h>
@@ -18,16 +21,7 @@
 #define MAX_TRANSFORMS 64
 #define MAX_BATCHES 4
 #define MAX_DRAWS 256
-
-typedef enum {
-  STREAM_VERTEX,
-  STREAM_DRAWID,
-  STREAM_INDEX,
-  STREAM_MODEL,
-  STREAM_COLOR,
-  STREAM_FRAME,
-  MAX_STREAMS
-} StreamType;
+#define MAX_PRIMITIVES 64
 
 typedef enum {
   BATCH_POINTS,
@@ -52,7 +46,7 @@ typedef union {
   struct { float r1; float r2; bool capped; int segments; } cylinder;
   struct { int segments; } sphere;
   struct { float u; float v; float w; float h; } fill;
-  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; float* pose; } mesh;
+  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; uint32_t pose; } mesh;
 } BatchParams;
 
 typedef struct {
@@ -68,8 +62,8 @@ typedef struct {
   uint32_t vertexCount;
   uint32_t indexCount;
   float** vertices;
-  uint16_t** indices;
-  uint16_t* baseVertex;
+  uint32_t** indices;
+  uint32_t* baseVertex;
   bool instanced;
 } BatchRequest;
 
@@ -85,6 +79,30 @@ typedef struct {
   bool indexed;
 } Batch;
 
+typedef struct {
+  uint64_t key;
+  BatchType type;
+  BatchParams params;
+  DrawMode topology;
+  Mesh* mesh;
+  Canvas* canvas;
+  Shader* shader;
+  Material* material;
+  Pipeline pipeline;
+  float transform[16];
+  Color color;
+  uint32_t vertexStart;
+  uint32_t vertexCount;
+  uint32_t indexStart;
+  uint32_t indexCount;
+  bool instanced;
+} DeferredDraw;
+
+typedef struct {
+  uint64_t key;
+  uint32_t index;
+} SortEntry;
+
 typedef struct {
   float viewMatrix[2][16];
   float projection[2][16];
@@ -119,13 +137,29 @@ static struct {
   Buffer* buffers[MAX_STREAMS];
   uint32_t head[MAX_STREAMS];
   uint32_t tail[MAX_STREAMS];
+  uint32_t poseEpoch;
+  uint32_t identityPose;
+  uint32_t identityPoseEpoch;
+  bool poseStorage;
   Batch batches[MAX_BATCHES];
   uint8_t batchCount;
+  bool frustumCulling;
+  bool deferred;
+  bool sortable;
+  uint8_t layer;
+  arr_t(DeferredDraw) draws;
+  arr_t(uint32_t) geometry;
+  arr_t(uint32_t) indices;
+  arr_t(SortEntry) sortEntries;
+  arr_t(Batch) sortedBatches;
+  arr_t(Mesh*) primitives;
+  map_t primitiveMap;
 } state;
 
-static const uint32_t bufferCount[] = {
-  [STREAM_VERTEX] = (1 << 16) - 1,
-  [STREAM_DRAWID] = (1 << 16) - 1,
+// The vertex and index counts can be changed in lovrGraphicsInit
+static uint32_t bufferCount[] = {
+  [STREAM_VERTEX] = 1 << 16,
+  [STREAM_DRAWID] = 1 << 16,
   [STREAM_INDEX] = 1 << 16,
 #if defined(LOVR_WEBGL) // Work around bugs where big UBOs don't work
   [STREAM_MODEL] = MAX_DRAWS,
@@ -134,16 +168,22 @@ static const uint32_t bufferCount[] = {
   [STREAM_MODEL] = MAX_DRAWS * MAX_BATCHES,
   [STREAM_COLOR] = MAX_DRAWS * MAX_BATCHES,
 #endif
-  [STREAM_FRAME] = 4
+  [STREAM_FRAME] = 4,
+#if defined(LOVR_WEBGL)
+  [STREAM_POSE] = 1 << 12
+#else
+  [STREAM_POSE] = 1 << 14
+#endif
 };
 
 static const size_t bufferStride[] = {
   [STREAM_VERTEX] = 8 * sizeof(float),
   [STREAM_DRAWID] = sizeof(uint8_t),
-  [STREAM_INDEX] = sizeof(uint16_t),
+  [STREAM_INDEX] = sizeof(uint32_t),
   [STREAM_MODEL] = 16 * sizeof(float),
   [STREAM_COLOR] = 4 * sizeof(float),
-  [STREAM_FRAME] = sizeof(FrameData)
+  [STREAM_FRAME] = sizeof(FrameData),
+  [STREAM_POSE] = 16 * sizeof(float)
 };
 
 static const BufferType bufferType[] = {
@@ -152,7 +192,8 @@ static const BufferType bufferType[] = {
   [STREAM_INDEX] = BUFFER_INDEX,
   [STREAM_MODEL] = BUFFER_UNIFORM,
   [STREAM_COLOR] = BUFFER_UNIFORM,
-  [STREAM_FRAME] = BUFFER_UNIFORM
+  [STREAM_FRAME] = BUFFER_UNIFORM,
+  [STREAM_POSE] = BUFFER_UNIFORM
 };
 
 static void gammaCorrect(Color* color) {
@@ -172,14 +213,23 @@ static void onResizeWindow(int width, int height) {
   state.defaultCanvas->height = height;
 }
 
+static void lovrGraphicsFlushFor(FlushReason reason);
+
 static void* lovrGraphicsMapBuffer(StreamType type, uint32_t count) {
-  lovrAssert(count <= bufferCount[type], "Whoa there!  Tried to get %d elements from a buffer that only has %d elements.", count, bufferCount[type]);
+  lovrAssert(count <= bufferCount[type], "Whoa there!  Tried to get %d elements from a buffer that only has %d elements (see t.graphics.streams in conf.lua)", count, bufferCount[type]);
 
-  if (state.head[type] + count > bufferCount[type]) {
-    lovrGraphicsFlush();
+  // Deferred draws need room at the end of the index stream to copy their sorted indices into
+  uint32_t reserved = type == STREAM_INDEX ? (uint32_t) state.indices.length : 0;
+
+  if (state.head[type] + reserved + count > bufferCount[type]) {
+    lovrGraphicsFlushFor(FLUSH_STREAM);
     lovrBufferDiscard(state.buffers[type]);
     state.tail[type] = 0;
     state.head[type] = 0;
+
+    if (type == STREAM_POSE) {
+      state.poseEpoch++;
+    }
   }
 
   return lovrBufferMap(state.buffers[type], state.head[type] * bufferStride[type]);
@@ -187,7 +237,12 @@ static void* lovrGraphicsMapBuffer(StreamType type, uint32_t count) {
 
 // Base
 
-bool lovrGraphicsInit() {
+bool lovrGraphicsInit(uint32_t vertexCount, uint32_t indexCount) {
+  lovrAssert(vertexCount > 0 && indexCount > 0, "Stream sizes must be positive");
+  lovrAssert(vertexCount <= MAX_STREAM_ELEMENTS && indexCount <= MAX_STREAM_ELEMENTS, "Stream sizes can't be more than %d", MAX_STREAM_ELEMENTS);
+  bufferCount[STREAM_VERTEX] = vertexCount;
+  bufferCount[STREAM_DRAWID] = vertexCount;
+  bufferCount[STREAM_INDEX] = indexCount;
   return false; // See lovrGraphicsCreateWindow for actual initialization
 }
 
@@ -208,6 +263,16 @@ void lovrGraphicsDestroy() {
   lovrRelease(Material, state.defaultMaterial);
   lovrRelease(Font, state.defaultFont);
   lovrRelease(Canvas, state.defaultCanvas);
+  arr_free(&state.draws);
+  arr_free(&state.geometry);
+  arr_free(&state.indices);
+  arr_free(&state.sortEntries);
+  arr_free(&state.sortedBatches);
+  for (size_t i = 0; i < state.primitives.length; i++) {
+    lovrRelease(Mesh, state.primitives.data[i]);
+  }
+  arr_free(&state.primitives);
+  map_free(&state.primitiveMap);
   lovrGpuDestroy();
   memset(&state, 0, sizeof(state));
 }
@@ -228,10 +293,29 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
 
   state.defaultCanvas = lovrCanvasCreateFromHandle(state.width, state.height, (CanvasFlags) { .stereo = false }, 0, 0, 0, 1, true);
 
+  // Skinning palettes go in a storage buffer when the shaders are new enough to read from one.
+  // Otherwise they're read from a uniform block that always covers MAX_BONES matrices, so the pose
+  // stream gets some padding at the end to keep those ranges in bounds.
+#if defined(LOVR_WEBGL) || defined(LOVR_GLES)
+  state.poseStorage = false;
+#else
+  state.poseStorage = lovrGraphicsGetFeatures()->compute;
+#endif
+
   for (int i = 0; i < MAX_STREAMS; i++) {
-    state.buffers[i] = lovrBufferCreate(bufferCount[i] * bufferStride[i], NULL, bufferType[i], USAGE_STREAM, false);
+    size_t size = bufferCount[i] * bufferStride[i];
+    BufferType type = bufferType[i];
+
+    if (i == STREAM_POSE) {
+      size += state.poseStorage ? 0 : MAX_BONES * bufferStride[i];
+      type = state.poseStorage ? BUFFER_SHADER_STORAGE : BUFFER_UNIFORM;
+    }
+
+    state.buffers[i] = lovrBufferCreate(size, NULL, type, USAGE_STREAM, false);
   }
 
+  state.poseEpoch = 1;
+
   // The identity buffer is used for autoinstanced meshes and instanced primitives and maps the
   // instance ID to a vertex attribute.  Its contents never change, so they are initialized here.
   state.identityBuffer = lovrBufferCreate(MAX_DRAWS * sizeof(uint8_t), NULL, BUFFER_VERTEX, USAGE_STATIC, false);
@@ -261,6 +345,14 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
   lovrMeshAttachAttribute(state.instancedMesh, "lovrTexCoord", &texCoord);
   lovrMeshAttachAttribute(state.instancedMesh, "lovrDrawID", &identity);
 
+  arr_init(&state.draws);
+  arr_init(&state.geometry);
+  arr_init(&state.indices);
+  arr_init(&state.sortEntries);
+  arr_init(&state.sortedBatches);
+  arr_init(&state.primitives);
+  map_init(&state.primitiveMap, MAX_PRIMITIVES);
+
   lovrGraphicsReset();
   state.initialized = true;
 }
@@ -289,7 +381,7 @@ const Camera* lovrGraphicsGetCamera() {
 }
 
 void lovrGraphicsSetCamera(Camera* camera, bool clear) {
-  lovrGraphicsFlush();
+  lovrGraphicsFlushFor(FLUSH_CAMERA);
 
   if (state.camera.canvas && (!camera || camera->canvas != state.camera.canvas)) {
     lovrCanvasResolve(state.camera.canvas);
@@ -337,7 +429,9 @@ void lovrGraphicsReset() {
   lovrGraphicsSetColorMask(true, true, true, true);
   lovrGraphicsSetCullingEnabled(false);
   lovrGraphicsSetDefaultFilter((TextureFilter) { .mode = FILTER_TRILINEAR });
+  lovrGraphicsSetDeferred(false);
   lovrGraphicsSetDepthTest(COMPARE_LEQUAL, true);
+  lovrGraphicsSetFrustumCullingEnabled(false);
   lovrGraphicsSetFont(NULL);
   lovrGraphicsSetLineWidth(1.f);
   lovrGraphicsSetPointSize(1.f);
@@ -427,6 +521,17 @@ void lovrGraphicsSetDefaultFilter(TextureFilter filter) {
   state.defaultFilter = filter;
 }
 
+bool lovrGraphicsIsDeferred() {
+  return state.deferred;
+}
+
+void lovrGraphicsSetDeferred(bool deferred) {
+  if (deferred != state.deferred) {
+    lovrGraphicsFlush();
+    state.deferred = deferred;
+  }
+}
+
 void lovrGraphicsGetDepthTest(CompareMode* mode, bool* write) {
   *mode = state.pipeline.depthTest;
   *write = state.pipeline.depthWrite;
@@ -437,6 +542,14 @@ void lovrGraphicsSetDepthTest(CompareMode mode, bool write) {
   state.pipeline.depthWrite = write;
 }
 
+bool lovrGraphicsIsFrustumCullingEnabled() {
+  return state.frustumCulling;
+}
+
+void lovrGraphicsSetFrustumCullingEnabled(bool enabled) {
+  state.frustumCulling = enabled;
+}
+
 Font* lovrGraphicsGetFont() {
   if (!state.font) {
     if (!state.defaultFont) {
@@ -544,7 +657,7 @@ void lovrGraphicsMatrixTransform(mat4 transform) {
 }
 
 void lovrGraphicsSetProjection(mat4 projection) {
-  lovrGraphicsFlush();
+  lovrGraphicsFlushFor(FLUSH_CAMERA);
   mat4_set(state.camera.projection[0], projection);
   mat4_set(state.camera.projection[1], projection);
   mat4_set(state.frameData.projection[0], projection);
@@ -554,6 +667,146 @@ void lovrGraphicsSetProjection(mat4 projection) {
 
 // Rendering
 
+static uint64_t sortBits(const void* data, size_t size, int bits) {
+  return hash64(data, size) >> (64 - bits);
+}
+
+// In deferred mode, draws are recorded into a list and sorted by a 64 bit key when flushed:
+//
+// layer:8 | canvas:4 | shader:10 | pipeline:8 | material:10 | geometry:8 | depth:16
+//
+// Opaque draws are grouped by state and drawn front to back within each group.  Draws that blend
+// or skip the depth test use their submission order as the key instead, and a new layer is started
+// whenever this changes so the two kinds of draws never pass each other.  Hash collisions in the
+// key only make batching worse, since batches still compare the full state.
+static void lovrGraphicsDefer(BatchRequest* req, Mesh* mesh, Canvas* canvas, Shader* shader, Pipeline* pipeline, Material* material) {
+  bool sortable = pipeline->blendMode == BLEND_NONE && pipeline->depthTest != COMPARE_NONE;
+
+  if (state.draws.length > 0 && sortable != state.sortable) {
+    if (state.layer == UINT8_MAX) {
+      lovrGraphicsFlush();
+    } else {
+      state.layer++;
+    }
+  }
+
+  state.sortable = sortable;
+
+  // Instanced primitives share their geometry with an earlier draw that has the same parameters
+  DeferredDraw* owner = NULL;
+  if (req->instanced && req->vertexCount > 0) {
+    for (size_t i = 0; i < state.geometry.length; i++) {
+      DeferredDraw* draw = &state.draws.data[state.geometry.data[i]];
+      if (draw->type == req->type && !memcmp(&draw->params, &req->params, sizeof(BatchParams))) {
+        owner = draw;
+        break;
+      }
+    }
+  }
+
+  uint32_t vertexStart = 0;
+  uint32_t indexStart = 0;
+
+  if (owner) {
+    vertexStart = owner->vertexStart;
+    indexStart = owner->indexStart;
+  } else if (req->vertexCount > 0) {
+    *(req->vertices) = lovrGraphicsMapBuffer(STREAM_VERTEX, req->vertexCount);
+    uint8_t* ids = lovrGraphicsMapBuffer(STREAM_DRAWID, req->vertexCount);
+
+    // Instanced geometry writes its indices in place.  Other indices go to a scratch buffer and are
+    // copied to the end of the index stream after sorting, so each batch has contiguous indices.
+    if (req->indexCount > 0) {
+      uint32_t* indices = lovrGraphicsMapBuffer(STREAM_INDEX, req->indexCount);
+
+      if (req->instanced) {
+        *(req->indices) = indices;
+        indexStart = state.head[STREAM_INDEX];
+        state.head[STREAM_INDEX] += req->indexCount;
+      } else {
+        indexStart = (uint32_t) state.indices.length;
+        arr_expand(&state.indices, req->indexCount);
+        *(req->indices) = state.indices.data + indexStart;
+        state.indices.length += req->indexCount;
+      }
+
+      *(req->baseVertex) = state.head[STREAM_VERTEX];
+    }
+
+    // Instanced geometry always uses a draw id of zero, other draw ids are written after sorting
+    if (req->instanced) {
+      memset(ids, 0, req->vertexCount * sizeof(uint8_t));
+      arr_push(&state.geometry, (uint32_t) state.draws.length);
+    }
+
+    vertexStart = state.head[STREAM_VERTEX];
+    state.head[STREAM_VERTEX] += req->vertexCount;
+    state.head[STREAM_DRAWID] += req->vertexCount;
+  }
+
+  arr_expand(&state.draws, 1);
+  DeferredDraw* draw = &state.draws.data[state.draws.length++];
+  *draw = (DeferredDraw) {
+    .type = req->type,
+    .params = req->params,
+    .topology = req->topology,
+    .mesh = mesh,
+    .canvas = canvas,
+    .shader = shader,
+    .material = material,
+    .pipeline = *pipeline,
+    .color = state.linearColor,
+    .vertexStart = vertexStart,
+    .vertexCount = req->vertexCount,
+    .indexStart = indexStart,
+    .indexCount = req->indexCount,
+    .instanced = req->instanced
+  };
+
+  mat4_init(draw->transform, state.transforms[state.transform]);
+  if (req->transform) {
+    mat4_multiply(draw->transform, req->transform);
+  }
+
+  draw->key = (uint64_t) state.layer << 56;
+
+  if (sortable) {
+    float* view = state.camera.viewMatrix[0];
+    float* position = &draw->transform[12];
+    float z = view[2] * position[0] + view[6] * position[1] + view[10] * position[2] + view[14];
+    union { float f; uint32_t u; } depth = { .f = MAX(-z, 0.f) };
+
+    struct { Mesh* mesh; BatchType type; BatchParams params; uint32_t start; } geometry;
+    memset(&geometry, 0, sizeof(geometry));
+    geometry.mesh = mesh;
+    geometry.type = req->type;
+    geometry.params = req->params;
+    geometry.start = req->instanced ? vertexStart : 0;
+
+    draw->key |= sortBits(&canvas, sizeof(Canvas*), 4) << 52;
+    draw->key |= sortBits(&shader, sizeof(Shader*), 10) << 42;
+    draw->key |= sortBits(pipeline, sizeof(Pipeline), 8) << 34;
+    draw->key |= sortBits(&material, sizeof(Material*), 10) << 24;
+    draw->key |= sortBits(&geometry, sizeof(geometry), 8) << 16;
+    draw->key |= depth.u >> 16; // Positive floats sort the same way as their bits
+  } else {
+    draw->key |= state.draws.length - 1;
+  }
+}
+
+// Returns the first thing that prevents a draw from being added to a batch, or MAX_BATCH_MISSES
+static BatchMiss lovrGraphicsCheckBatch(Batch* batch, BatchType type, Mesh* mesh, Canvas* canvas, Shader* shader, Material* material, Pipeline* pipeline, BatchParams* params) {
+  if (batch->type != type) return MISS_TYPE;
+  if (batch->drawCount >= MAX_DRAWS) return MISS_FULL;
+  if (batch->draw.mesh != mesh) return MISS_MESH;
+  if (batch->draw.canvas != canvas) return MISS_CANVAS;
+  if (batch->draw.shader != shader) return MISS_SHADER;
+  if (batch->material != material) return MISS_MATERIAL;
+  if (memcmp(&batch->draw.pipeline, pipeline, sizeof(Pipeline))) return MISS_PIPELINE;
+  if (memcmp(&batch->params, params, sizeof(BatchParams))) return MISS_PARAMS;
+  return MAX_BATCH_MISSES;
+}
+
 static void lovrGraphicsBatch(BatchRequest* req) {
 
   // Resolve objects
@@ -571,12 +824,19 @@ static void lovrGraphicsBatch(BatchRequest* req) {
     }
   }
 
-  if (req->type == BATCH_MESH && lovrShaderHasUniform(shader, "lovrPose")) {
-    if (req->params.mesh.pose) {
-      lovrShaderSetMatrices(shader, "lovrPose", req->params.mesh.pose, 0, MAX_BONES * 16);
-    } else {
-      lovrShaderSetMatrices(shader, "lovrPose", (float[]) MAT4_IDENTITY, 0, 16);
+  // Meshes without a pose still need an identity matrix for animated shaders
+  if (req->type == BATCH_MESH && req->params.mesh.pose == ~0u) {
+    if (state.identityPoseEpoch != state.poseEpoch) {
+      state.identityPose = lovrGraphicsUploadPose((float[]) MAT4_IDENTITY, 1);
+      state.identityPoseEpoch = state.poseEpoch;
     }
+
+    req->params.mesh.pose = state.identityPose;
+  }
+
+  if (state.deferred) {
+    lovrGraphicsDefer(req, mesh, canvas, shader, pipeline, material);
+    return;
   }
 
   // Try to find an existing batch to use
@@ -585,18 +845,15 @@ static void lovrGraphicsBatch(BatchRequest* req) {
     if (req->type == BATCH_MESH && req->params.mesh.instances > 1) { break; }
 
     Batch* b = &state.batches[i];
-    if (b->type != req->type) { goto next; }
-    if (b->drawCount >= MAX_DRAWS) { goto next; }
-    if (b->draw.mesh != mesh) { goto next; }
-    if (b->draw.canvas != canvas) { goto next; }
-    if (b->draw.shader != shader) { goto next; }
-    if (b->material != material) { goto next; }
-    if (memcmp(&b->draw.pipeline, pipeline, sizeof(Pipeline))) { goto next; }
-    if (memcmp(&b->params, &req->params, sizeof(BatchParams))) { goto next; }
-    batch = b;
-    break;
-
-next:
+    BatchMiss miss = lovrGraphicsCheckBatch(b, req->type, mesh, canvas, shader, material, pipeline, &req->params);
+
+    if (miss == MAX_BATCH_MISSES) {
+      batch = b;
+      break;
+    }
+
+    lovrGpuGetStats()->batchMisses[miss]++;
+
     // Draws can't be reordered when blending is on, depth test is off, or either of the batches
     // are streaming their vertices (since the vertices of a batch must be contiguous)
     if (b->draw.pipeline.blendMode != BLEND_NONE || pipeline->blendMode != BLEND_NONE) { break; }
@@ -622,7 +879,7 @@ next:
   // Start a new batch
   if (!batch || state.batchCount == 0) {
     if (state.batchCount >= MAX_BATCHES) {
-      lovrGraphicsFlush();
+      lovrGraphicsFlushFor(FLUSH_BATCHES);
     }
 
     float* transforms = lovrGraphicsMapBuffer(STREAM_MODEL, MAX_DRAWS);
@@ -695,7 +952,7 @@ next:
   batch->drawCount++;
 }
 
-void lovrGraphicsFlush() {
+static void lovrGraphicsSubmit(void) {
   if (state.batchCount == 0) {
     return;
   }
@@ -712,7 +969,9 @@ void lovrGraphicsFlush() {
   }
 
   // Flush buffers
+  GpuStats* stats = lovrGpuGetStats();
   for (int i = 0; i < MAX_STREAMS; i++) {
+    stats->streamBytes[i] += (state.head[i] - state.tail[i]) * bufferStride[i];
     lovrBufferFlush(state.buffers[i], state.tail[i] * bufferStride[i], (state.head[i] - state.tail[i]) * bufferStride[i]);
     lovrBufferUnmap(state.buffers[i]);
     state.tail[i] = state.head[i];
@@ -726,6 +985,11 @@ void lovrGraphicsFlush() {
     lovrShaderSetBlock(batch->draw.shader, "lovrModelBlock", state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], MAX_DRAWS * bufferStride[STREAM_MODEL], ACCESS_READ);
     lovrShaderSetBlock(batch->draw.shader, "lovrColorBlock", state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], MAX_DRAWS * bufferStride[STREAM_COLOR], ACCESS_READ);
     lovrShaderSetBlock(batch->draw.shader, "lovrFrameBlock", state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
+    if (batch->type == BATCH_MESH) {
+      size_t offset = batch->params.mesh.pose * bufferStride[STREAM_POSE];
+      size_t size = state.poseStorage ? bufferCount[STREAM_POSE] * bufferStride[STREAM_POSE] - offset : MAX_BONES * bufferStride[STREAM_POSE];
+      lovrShaderSetBlock(batch->draw.shader, "lovrPoseBlock", state.buffers[STREAM_POSE], offset, size, ACCESS_READ);
+    }
     if (batch->draw.topology == DRAW_POINTS) {
       lovrShaderSetFloats(batch->draw.shader, "lovrPointSize", &state.pointSize, 0, 1);
     }
@@ -739,7 +1003,7 @@ void lovrGraphicsFlush() {
       }
 
       if (batch->indexed) {
-        lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], bufferCount[STREAM_INDEX], sizeof(uint16_t), 0);
+        lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], bufferCount[STREAM_INDEX], sizeof(uint32_t), 0);
       } else {
         lovrMeshSetIndexBuffer(batch->draw.mesh, NULL, 0, 0, 0);
       }
@@ -749,10 +1013,258 @@ void lovrGraphicsFlush() {
   }
 }
 
+static SortEntry* lovrGraphicsSort(SortEntry* entries, SortEntry* scratch, size_t count) {
+  for (int shift = 0; shift < 64; shift += 8) {
+    uint32_t offsets[256] = { 0 };
+
+    for (size_t i = 0; i < count; i++) {
+      offsets[(entries[i].key >> shift) & 0xff]++;
+    }
+
+    // Skip the pass if every key has the same digit
+    if (offsets[(entries[0].key >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    for (uint32_t i = 0, total = 0; i < 256; i++) {
+      uint32_t n = offsets[i];
+      offsets[i] = total;
+      total += n;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      scratch[offsets[(entries[i].key >> shift) & 0xff]++] = entries[i];
+    }
+
+    SortEntry* swap = entries;
+    entries = scratch;
+    scratch = swap;
+  }
+
+  return entries;
+}
+
+static void lovrGraphicsFlushDeferred(void) {
+
+  // The list is emptied up front so flushes triggered while submitting don't see it
+  DeferredDraw* draws = state.draws.data;
+  size_t count = state.draws.length;
+  arr_clear(&state.draws);
+  arr_clear(&state.geometry);
+  state.layer = 0;
+
+  arr_reserve(&state.sortEntries, 2 * count);
+  SortEntry* entries = state.sortEntries.data;
+  for (size_t i = 0; i < count; i++) {
+    entries[i] = (SortEntry) { draws[i].key, (uint32_t) i };
+  }
+
+  entries = lovrGraphicsSort(entries, entries + count, count);
+
+  // Resolve the sorted draws into batches.  Draw ids and sorted indices are written here, before
+  // anything is submitted, so they get flushed along with everything else.
+  uint8_t* ids = lovrBufferMap(state.buffers[STREAM_DRAWID], 0);
+  uint32_t* indices = lovrBufferMap(state.buffers[STREAM_INDEX], 0);
+  arr_clear(&state.sortedBatches);
+  Batch* batch = NULL;
+
+  for (size_t i = 0; i < count; i++) {
+    DeferredDraw* draw = &draws[entries[i].index];
+
+    bool compatible = false;
+    if (batch && !(draw->type == BATCH_MESH && draw->params.mesh.instances > 1)) {
+      BatchMiss miss = lovrGraphicsCheckBatch(batch, draw->type, draw->mesh, draw->canvas, draw->shader, draw->material, &draw->pipeline, &draw->params);
+      compatible = miss == MAX_BATCH_MISSES;
+      if (!compatible) {
+        lovrGpuGetStats()->batchMisses[miss]++;
+      }
+    }
+
+    // Instances have to share geometry, and streamed vertices have to be contiguous
+    if (compatible && draw->type != BATCH_MESH) {
+      if (draw->instanced) {
+        compatible = batch->draw.rangeStart == (batch->indexed ? draw->indexStart : draw->vertexStart);
+      } else if (!batch->indexed) {
+        compatible = batch->draw.rangeStart + batch->draw.rangeCount == draw->vertexStart;
+      }
+    }
+
+    if (!compatible) {
+      uint32_t rangeStart, rangeCount, instances;
+      if (draw->type == BATCH_MESH) {
+        rangeStart = draw->params.mesh.rangeStart;
+        rangeCount = draw->params.mesh.rangeCount;
+        instances = draw->instanced ? 0 : draw->params.mesh.instances;
+      } else if (draw->instanced) {
+        rangeStart = draw->indexCount > 0 ? draw->indexStart : draw->vertexStart;
+        rangeCount = draw->indexCount > 0 ? draw->indexCount : draw->vertexCount;
+        instances = 0;
+      } else {
+        rangeStart = draw->indexCount > 0 ? state.head[STREAM_INDEX] : draw->vertexStart;
+        rangeCount = 0;
+        instances = 0;
+      }
+
+      arr_push(&state.sortedBatches, ((Batch) {
+        .type = draw->type,
+        .params = draw->params,
+        .draw = {
+          .mesh = draw->mesh,
+          .canvas = draw->canvas,
+          .shader = draw->shader,
+          .pipeline = draw->pipeline,
+          .topology = draw->topology,
+          .rangeStart = rangeStart,
+          .rangeCount = rangeCount,
+          .instances = instances
+        },
+        .material = draw->material,
+        .indexed = draw->indexCount > 0
+      }));
+
+      batch = &state.sortedBatches.data[state.sortedBatches.length - 1];
+    }
+
+    if (!draw->instanced) {
+      if (draw->indexCount > 0) {
+        memcpy(indices + state.head[STREAM_INDEX], state.indices.data + draw->indexStart, draw->indexCount * sizeof(uint32_t));
+        state.head[STREAM_INDEX] += draw->indexCount;
+        batch->draw.rangeCount += draw->indexCount;
+      } else {
+        batch->draw.rangeCount += draw->vertexCount;
+      }
+
+      memset(ids + draw->vertexStart, batch->drawCount, draw->vertexCount * sizeof(uint8_t));
+    } else {
+      batch->draw.instances++;
+    }
+
+    batch->drawCount++;
+  }
+
+  arr_clear(&state.indices);
+
+  // Submit the batches, writing their transforms and colors as space becomes available
+  size_t cursor = 0;
+  for (size_t b = 0; b < state.sortedBatches.length; b++) {
+    bool full = state.head[STREAM_MODEL] + MAX_DRAWS > bufferCount[STREAM_MODEL] || state.head[STREAM_COLOR] + MAX_DRAWS > bufferCount[STREAM_COLOR];
+
+    if (state.batchCount >= MAX_BATCHES || full) {
+      lovrGraphicsSubmit();
+
+      if (full) {
+        StreamType streams[] = { STREAM_MODEL, STREAM_COLOR };
+        for (int i = 0; i < 2; i++) {
+          lovrBufferDiscard(state.buffers[streams[i]]);
+          state.tail[streams[i]] = 0;
+          state.head[streams[i]] = 0;
+        }
+      }
+    }
+
+    batch = &state.batches[state.batchCount++];
+    *batch = state.sortedBatches.data[b];
+    batch->transforms = lovrBufferMap(state.buffers[STREAM_MODEL], state.head[STREAM_MODEL] * bufferStride[STREAM_MODEL]);
+    batch->colors = lovrBufferMap(state.buffers[STREAM_COLOR], state.head[STREAM_COLOR] * bufferStride[STREAM_COLOR]);
+    batch->drawStart = state.head[STREAM_MODEL];
+    state.head[STREAM_MODEL] += MAX_DRAWS;
+    state.head[STREAM_COLOR] += MAX_DRAWS;
+
+    for (uint32_t i = 0; i < batch->drawCount; i++) {
+      DeferredDraw* draw = &draws[entries[cursor++].index];
+      memcpy(&batch->transforms[16 * i], draw->transform, 16 * sizeof(float));
+      batch->colors[i] = draw->color;
+    }
+  }
+
+  lovrGraphicsSubmit();
+}
+
+static void lovrGraphicsFlushFor(FlushReason reason) {
+  if (state.draws.length > 0) {
+    lovrGpuGetStats()->flushes[reason]++;
+    lovrGraphicsFlushDeferred();
+  } else if (state.batchCount > 0) {
+    lovrGpuGetStats()->flushes[reason]++;
+    lovrGraphicsSubmit();
+  }
+}
+
+void lovrGraphicsFlush() {
+  lovrGraphicsFlushFor(FLUSH_OTHER);
+}
+
+// Instanced primitives are drawn using unit meshes that are built the first time they're needed and
+// kept around, so only the transform and color of each draw gets uploaded.  Geometry is written to
+// the mesh the same way it would be streamed (with a base vertex of zero).  Once the cache is full,
+// new shapes fall back to streaming their geometry.
+static void lovrGraphicsPrimitive(BatchRequest* req) {
+  struct { BatchType type; BatchParams params; } key;
+  memset(&key, 0, sizeof(key));
+  key.type = req->type;
+  key.params = req->params;
+  uint64_t hash = hash64(&key, sizeof(key));
+  uint64_t index = map_get(&state.primitiveMap, hash);
+
+  Mesh* mesh;
+  if (index != MAP_NIL) {
+    mesh = state.primitives.data[index];
+  } else if (state.primitives.length < MAX_PRIMITIVES) {
+    size_t stride = bufferStride[STREAM_VERTEX];
+    Buffer* vertexBuffer = lovrBufferCreate(req->vertexCount * stride, NULL, BUFFER_VERTEX, USAGE_STATIC, false);
+    mesh = lovrMeshCreate(req->topology, vertexBuffer, req->vertexCount);
+    lovrMeshAttachAttribute(mesh, "lovrPosition", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 });
+    lovrMeshAttachAttribute(mesh, "lovrNormal", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 });
+    lovrMeshAttachAttribute(mesh, "lovrTexCoord", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 });
+    lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) { .buffer = state.identityBuffer, .type = U8, .components = 1, .divisor = 1, .integer = true });
+    *(req->vertices) = lovrBufferMap(vertexBuffer, 0);
+    lovrBufferFlush(vertexBuffer, 0, req->vertexCount * stride);
+    lovrRelease(Buffer, vertexBuffer);
+
+    if (req->indexCount > 0) {
+      Buffer* indexBuffer = lovrBufferCreate(req->indexCount * sizeof(uint32_t), NULL, BUFFER_INDEX, USAGE_STATIC, false);
+      lovrMeshSetIndexBuffer(mesh, indexBuffer, req->indexCount, sizeof(uint32_t), 0);
+      *(req->indices) = lovrBufferMap(indexBuffer, 0);
+      *(req->baseVertex) = 0;
+      lovrBufferFlush(indexBuffer, 0, req->indexCount * sizeof(uint32_t));
+      lovrRelease(Buffer, indexBuffer);
+    }
+
+    map_set(&state.primitiveMap, hash, state.primitives.length);
+    arr_push(&state.primitives, mesh);
+  } else {
+    lovrGraphicsBatch(req);
+    return;
+  }
+
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_MESH,
+    .params.mesh.rangeStart = 0,
+    .params.mesh.rangeCount = req->indexCount > 0 ? req->indexCount : req->vertexCount,
+    .params.mesh.instances = 1,
+    .params.mesh.pose = ~0u,
+    .shader = req->shader,
+    .mesh = mesh,
+    .topology = req->topology,
+    .pipeline = req->pipeline,
+    .material = req->material,
+    .texture = req->texture,
+    .transform = req->transform,
+    .instanced = true
+  });
+}
+
 void lovrGraphicsFlushCanvas(Canvas* canvas) {
   for (int i = state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.canvas == canvas) {
-      lovrGraphicsFlush();
+      lovrGraphicsFlushFor(FLUSH_CANVAS);
+      return;
+    }
+  }
+
+  for (size_t i = state.draws.length; i-- > 0;) {
+    if (state.draws.data[i].canvas == canvas) {
+      lovrGraphicsFlushFor(FLUSH_CANVAS);
       return;
     }
   }
@@ -761,7 +1273,14 @@ void lovrGraphicsFlushCanvas(Canvas* canvas) {
 void lovrGraphicsFlushShader(Shader* shader) {
   for (int i = state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.shader == shader) {
-      lovrGraphicsFlush();
+      lovrGraphicsFlushFor(FLUSH_SHADER);
+      return;
+    }
+  }
+
+  for (size_t i = state.draws.length; i-- > 0;) {
+    if (state.draws.data[i].shader == shader) {
+      lovrGraphicsFlushFor(FLUSH_SHADER);
       return;
     }
   }
@@ -770,7 +1289,14 @@ void lovrGraphicsFlushShader(Shader* shader) {
 void lovrGraphicsFlushMaterial(Material* material) {
   for (int i = state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].material == material) {
-      lovrGraphicsFlush();
+      lovrGraphicsFlushFor(FLUSH_MATERIAL);
+      return;
+    }
+  }
+
+  for (size_t i = state.draws.length; i-- > 0;) {
+    if (state.draws.data[i].material == material) {
+      lovrGraphicsFlushFor(FLUSH_MATERIAL);
       return;
     }
   }
@@ -779,7 +1305,14 @@ void lovrGraphicsFlushMaterial(Material* material) {
 void lovrGraphicsFlushMesh(Mesh* mesh) {
   for (int i = state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.mesh == mesh) {
-      lovrGraphicsFlush();
+      lovrGraphicsFlushFor(FLUSH_MESH);
+      return;
+    }
+  }
+
+  for (size_t i = state.draws.length; i-- > 0;) {
+    if (state.draws.data[i].mesh == mesh) {
+      lovrGraphicsFlushFor(FLUSH_MESH);
       return;
     }
   }
@@ -809,8 +1342,8 @@ void lovrGraphicsPoints(uint32_t count, float** vertices) {
 
 void lovrGraphicsLine(uint32_t count, float** vertices) {
   uint32_t indexCount = count + 1;
-  uint16_t* indices;
-  uint16_t baseVertex;
+  uint32_t* indices;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_LINES,
@@ -822,7 +1355,7 @@ void lovrGraphicsLine(uint32_t count, float** vertices) {
     .baseVertex = &baseVertex
   });
 
-  indices[0] = 0xffff;
+  indices[0] = 0xffffffff;
   for (uint32_t i = 1; i < indexCount; i++) {
     indices[i] = baseVertex + i - 1;
   }
@@ -830,8 +1363,8 @@ void lovrGraphicsLine(uint32_t count, float** vertices) {
 
 void lovrGraphicsTriangle(DrawStyle style, Material* material, uint32_t count, float** vertices) {
   uint32_t indexCount = style == STYLE_LINE ? (4 * count / 3) : 0;
-  uint16_t* indices;
-  uint16_t baseVertex;
+  uint32_t* indices;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_TRIANGLES,
@@ -847,7 +1380,7 @@ void lovrGraphicsTriangle(DrawStyle style, Material* material, uint32_t count, f
 
   if (style == STYLE_LINE) {
     for (uint32_t i = 0; i < count; i += 3) {
-      *indices++ = 0xffff;
+      *indices++ = 0xffffffff;
       *indices++ = baseVertex + i + 0;
       *indices++ = baseVertex + i + 1;
       *indices++ = baseVertex + i + 2;
@@ -857,8 +1390,8 @@ void lovrGraphicsTriangle(DrawStyle style, Material* material, uint32_t count, f
 
 void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, float u, float v, float w, float h) {
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_PLANE,
@@ -883,7 +1416,7 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
 
     memcpy(vertices, vertexData, sizeof(vertexData));
 
-    indices[0] = 0xffff;
+    indices[0] = 0xffffffff;
     indices[1] = 0 + baseVertex;
     indices[2] = 1 + baseVertex;
     indices[3] = 2 + baseVertex;
@@ -898,7 +1431,7 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
 
     memcpy(vertices, vertexData, sizeof(vertexData));
 
-    static uint16_t indexData[] = { 0, 1, 2, 2, 1, 3 };
+    static uint32_t indexData[] = { 0, 1, 2, 2, 1, 3 };
 
     for (size_t i = 0; i < sizeof(indexData) / sizeof(indexData[0]); i++) {
       indices[i] = indexData[i] + baseVertex;
@@ -908,10 +1441,10 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
 
 void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_BOX,
     .params.box.style = style,
     .topology = style == STYLE_LINE ? DRAW_LINES : DRAW_TRIANGLES,
@@ -940,7 +1473,7 @@ void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
 
       memcpy(vertices, vertexData, sizeof(vertexData));
 
-      static uint16_t indexData[] = {
+      static uint32_t indexData[] = {
         0, 1, 1, 2, 2, 3, 3, 0, // Front
         4, 5, 5, 6, 6, 7, 7, 4, // Back
         0, 4, 1, 5, 2, 6, 3, 7  // Connections
@@ -979,7 +1512,7 @@ void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
 
       memcpy(vertices, vertexData, sizeof(vertexData));
 
-      uint16_t indexData[] = {
+      uint32_t indexData[] = {
         0,  1,   2,  2,  1,  3,
         4,  5,   6,  6,  5,  7,
         8,  9,  10, 10,  9, 11,
@@ -1008,7 +1541,7 @@ void lovrGraphicsArc(DrawStyle style, ArcMode mode, Material* material, mat4 tra
   uint32_t vertexCount = segments + 1 + hasCenterPoint;
   float* vertices = NULL;
 
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_ARC,
     .params.arc.r1 = r1,
     .params.arc.r2 = r2,
@@ -1051,13 +1584,21 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
   r1 /= length;
   r2 /= length;
 
+  // Cylinders with the same shape share geometry, the radius is moved into the transform
+  float radius = MAX(r1, r2);
+  if (radius > 0.f) {
+    mat4_scale(transform, radius, radius, 1.f);
+    r1 /= radius;
+    r2 /= radius;
+  }
+
   uint32_t vertexCount = ((capped && r1) * (segments + 2) + (capped && r2) * (segments + 2) + 2 * (segments + 1));
   uint32_t indexCount = 3 * segments * ((capped && r1) + (capped && r2) + 2);
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_CYLINDER,
     .params.cylinder.r1 = r1,
     .params.cylinder.r2 = r2,
@@ -1116,16 +1657,16 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
     // Indices
     for (int i = 0; i < segments; i++) {
       int j = 2 * i + baseVertex;
-      memcpy(indices, (uint16_t[6]) { j, j + 2, j + 1, j + 1, j + 2, j + 3 }, 6 * sizeof(uint16_t));
+      memcpy(indices, (uint32_t[6]) { j, j + 2, j + 1, j + 1, j + 2, j + 3 }, 6 * sizeof(uint32_t));
       indices += 6;
 
       if (capped && r1 != 0.f) {
-        memcpy(indices, (uint16_t[3]) { top, top + i + 2, top + i + 1 }, 3 * sizeof(uint16_t));
+        memcpy(indices, (uint32_t[3]) { top, top + i + 2, top + i + 1 }, 3 * sizeof(uint32_t));
         indices += 3;
       }
 
       if (capped && r2 != 0.f) {
-        memcpy(indices, (uint16_t[3]) { bot, bot + i + 1, bot + i + 2 }, 3 * sizeof(uint16_t));
+        memcpy(indices, (uint32_t[3]) { bot, bot + i + 1, bot + i + 2 }, 3 * sizeof(uint32_t));
         indices += 3;
       }
     }
@@ -1134,10 +1675,10 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
 
 void lovrGraphicsSphere(Material* material, mat4 transform, int segments) {
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_SPHERE,
     .params.sphere.segments = segments,
     .topology = DRAW_TRIANGLES,
@@ -1167,12 +1708,12 @@ void lovrGraphicsSphere(Material* material, mat4 transform, int segments) {
     }
 
     for (int i = 0; i < segments; i++) {
-      uint16_t offset0 = i * (segments + 1) + baseVertex;
-      uint16_t offset1 = (i + 1) * (segments + 1) + baseVertex;
+      uint32_t offset0 = i * (segments + 1) + baseVertex;
+      uint32_t offset1 = (i + 1) * (segments + 1) + baseVertex;
       for (int j = 0; j < segments; j++) {
-        uint16_t i0 = offset0 + j;
-        uint16_t i1 = offset1 + j;
-        memcpy(indices, ((uint16_t[]) { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 }), 6 * sizeof(uint16_t));
+        uint32_t i0 = offset0 + j;
+        uint32_t i1 = offset1 + j;
+        memcpy(indices, ((uint32_t[]) { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 }), 6 * sizeof(uint32_t));
         indices += 6;
       }
     }
@@ -1227,8 +1768,8 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
   pipeline.blendMode = pipeline.blendMode == BLEND_NONE ? BLEND_ALPHA : pipeline.blendMode;
 
   float* vertices;
-  uint16_t* indices;
-  uint16_t baseVertex;
+  uint32_t* indices;
+  uint32_t baseVertex;
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_TEXT,
     .topology = DRAW_TRIANGLES,
@@ -1274,7 +1815,77 @@ void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
   }
 }
 
-void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose) {
+// Tests an object space bounding box against the frustum of each eye, using the planes of the
+// combined clip matrix.  The box is visible if its most positive corner is in front of every plane.
+static bool lovrGraphicsIsVisible(float bounds[6], mat4 transform) {
+  float model[16];
+  mat4_init(model, state.transforms[state.transform]);
+  if (transform) {
+    mat4_multiply(model, transform);
+  }
+
+  for (int eye = 0; eye < (state.camera.stereo ? 2 : 1); eye++) {
+    float m[16];
+    mat4_init(m, state.camera.projection[eye]);
+    mat4_multiply(m, state.camera.viewMatrix[eye]);
+    mat4_multiply(m, model);
+
+    bool inside = true;
+    for (int i = 0; i < 6 && inside; i++) {
+      int row = i / 2;
+      float sign = (i & 1) ? -1.f : 1.f;
+      float a = m[3] + sign * m[row + 0];
+      float b = m[7] + sign * m[row + 4];
+      float c = m[11] + sign * m[row + 8];
+      float d = m[15] + sign * m[row + 12];
+      float x = a > 0.f ? bounds[1] : bounds[0];
+      float y = b > 0.f ? bounds[3] : bounds[2];
+      float z = c > 0.f ? bounds[5] : bounds[4];
+      inside = a * x + b * y + c * z + d >= 0.f;
+    }
+
+    if (inside) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t lovrGraphicsGetPoseEpoch() {
+  return state.poseEpoch;
+}
+
+// Copies a skinning palette to the pose stream and returns its location there, which can be passed
+// to lovrGraphicsDrawMesh.  The palette stays in the stream until the epoch changes, so it can be
+// reused by later draws (and frames) until then.  Palettes start on a block alignment boundary.
+uint32_t lovrGraphicsUploadPose(float* pose, uint32_t boneCount) {
+  if (!state.poseStorage) {
+    boneCount = MIN(boneCount, MAX_BONES);
+  }
+
+  uint32_t align = MAX(lovrGraphicsGetLimits()->blockAlign / (int) bufferStride[STREAM_POSE], 1);
+  uint32_t count = (boneCount + align - 1) / align * align;
+  float* data = lovrGraphicsMapBuffer(STREAM_POSE, count);
+  memcpy(data, pose, boneCount * 16 * sizeof(float));
+  uint32_t offset = state.head[STREAM_POSE];
+  state.head[STREAM_POSE] += count;
+  return offset;
+}
+
+void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, uint32_t pose) {
+  float bounds[6];
+
+  // Instanced and skinned meshes can end up anywhere, so they are never culled
+  if (state.frustumCulling && instances <= 1 && pose == ~0u && lovrMeshGetBounds(mesh, bounds)) {
+    GpuStats* stats = lovrGpuGetStats();
+    if (!lovrGraphicsIsVisible(bounds, transform)) {
+      stats->culledDraws++;
+      return;
+    }
+    stats->visibleDraws++;
+  }
+
   uint32_t vertexCount = lovrMeshGetVertexCount(mesh);
   uint32_t indexCount = lovrMeshGetIndexCount(mesh);
   uint32_t defaultCount = indexCount > 0 ? indexCount : vertexCount;
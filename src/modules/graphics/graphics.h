@@ -8,6 +8,8 @@
 
 #pragma once
 
+#define MAX_STREAM_ELEMENTS (1 << 24)
+
 struct Buffer;
 struct Canvas;
 struct Font;
@@ -92,7 +94,7 @@ typedef struct {
 } Pipeline;
 
 // Base
-bool lovrGraphicsInit();
+bool lovrGraphicsInit(uint32_t vertexCount, uint32_t indexCount);
 void lovrGraphicsDestroy(void);
 void lovrGraphicsPresent(void);
 void lovrGraphicsCreateWindow(WindowFlags* flags);
@@ -126,8 +128,12 @@ bool lovrGraphicsIsCullingEnabled(void);
 void lovrGraphicsSetCullingEnabled(bool culling);
 TextureFilter lovrGraphicsGetDefaultFilter(void);
 void lovrGraphicsSetDefaultFilter(TextureFilter filter);
+bool lovrGraphicsIsDeferred(void);
+void lovrGraphicsSetDeferred(bool deferred);
 void lovrGraphicsGetDepthTest(CompareMode* mode, bool* write);
 void lovrGraphicsSetDepthTest(CompareMode depthTest, bool write);
+bool lovrGraphicsIsFrustumCullingEnabled(void);
+void lovrGraphicsSetFrustumCullingEnabled(bool enabled);
 struct Font* lovrGraphicsGetFont(void);
 void lovrGraphicsSetFont(struct Font* font);
 float lovrGraphicsGetLineWidth(void);
@@ -173,7 +179,9 @@ void lovrGraphicsSphere(struct Material* material, mat4 transform, int segments)
 void lovrGraphicsSkybox(struct Texture* texture);
 void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign);
 void lovrGraphicsFill(struct Texture* texture, float u, float v, float w, float h);
-void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, float* pose);
+uint32_t lovrGraphicsGetPoseEpoch(void);
+uint32_t lovrGraphicsUploadPose(float* pose, uint32_t boneCount);
+void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, uint32_t pose);
 #define lovrGraphicsStencil lovrGpuStencil
 #define lovrGraphicsCompute lovrGpuCompute
 
@@ -198,9 +206,52 @@ typedef struct {
   int blockAlign;
 } GpuLimits;
 
+typedef enum {
+  STREAM_VERTEX,
+  STREAM_DRAWID,
+  STREAM_INDEX,
+  STREAM_MODEL,
+  STREAM_COLOR,
+  STREAM_FRAME,
+  STREAM_POSE,
+  MAX_STREAMS
+} StreamType;
+
+typedef enum {
+  FLUSH_OTHER,
+  FLUSH_STREAM,
+  FLUSH_BATCHES,
+  FLUSH_CANVAS,
+  FLUSH_SHADER,
+  FLUSH_MATERIAL,
+  FLUSH_MESH,
+  FLUSH_CAMERA,
+  MAX_FLUSH_REASONS
+} FlushReason;
+
+typedef enum {
+  MISS_TYPE,
+  MISS_FULL,
+  MISS_MESH,
+  MISS_CANVAS,
+  MISS_SHADER,
+  MISS_MATERIAL,
+  MISS_PIPELINE,
+  MISS_PARAMS,
+  MAX_BATCH_MISSES
+} BatchMiss;
+
 typedef struct {
   uint32_t shaderSwitches;
   uint32_t drawCalls;
+  uint32_t fenceWaits;
+  uint32_t culledDraws;
+  uint32_t visibleDraws;
+  uint32_t textureBinds;
+  uint32_t pipelineChanges;
+  uint32_t flushes[MAX_FLUSH_REASONS];
+  uint32_t batchMisses[MAX_BATCH_MISSES];
+  uint64_t streamBytes[MAX_STREAMS];
 } GpuStats;
 
 typedef struct {
@@ -227,4 +278,4 @@ void lovrGpuTick(const char* label);
 double lovrGpuTock(const char* label);
 const GpuFeatures* lovrGpuGetFeatures(void);
 const GpuLimits* lovrGpuGetLimits(void);
-const GpuStats* lovrGpuGetStats(void);
+GpuStats* lovrGpuGetStats(void);
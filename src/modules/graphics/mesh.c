@@ -104,6 +104,21 @@ void lovrMeshSetDrawRange(Mesh* mesh, uint32_t start, uint32_t count) {
   mesh->drawCount = count;
 }
 
+bool lovrMeshGetBounds(Mesh* mesh, float bounds[6]) {
+  if (mesh->hasBounds) {
+    memcpy(bounds, mesh->bounds, sizeof(mesh->bounds));
+  }
+
+  return mesh->hasBounds;
+}
+
+void lovrMeshSetBounds(Mesh* mesh, float bounds[6]) {
+  mesh->hasBounds = bounds != NULL;
+  if (bounds) {
+    memcpy(mesh->bounds, bounds, sizeof(mesh->bounds));
+  }
+}
+
 Material* lovrMeshGetMaterial(Mesh* mesh) {
   return mesh->material;
 }
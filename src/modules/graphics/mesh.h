@@ -40,6 +40,8 @@ typedef struct Mesh {
   size_t indexOffset;
   uint32_t drawStart;
   uint32_t drawCount;
+  float bounds[6];
+  bool hasBounds;
   struct Material* material;
   GPU_MESH_FIELDS
 } Mesh;
@@ -62,5 +64,7 @@ DrawMode lovrMeshGetDrawMode(Mesh* mesh);
 void lovrMeshSetDrawMode(Mesh* mesh, DrawMode mode);
 void lovrMeshGetDrawRange(Mesh* mesh, uint32_t* start, uint32_t* count);
 void lovrMeshSetDrawRange(Mesh* mesh, uint32_t start, uint32_t count);
+bool lovrMeshGetBounds(Mesh* mesh, float bounds[6]);
+void lovrMeshSetBounds(Mesh* mesh, float bounds[6]);
 struct Material* lovrMeshGetMaterial(Mesh* mesh);
 void lovrMeshSetMaterial(Mesh* mesh, struct Material* material);
@@ -6,6 +6,7 @@
 #include "graphics/texture.h"
 #include "resources/shaders.h"
 #include "core/maf.h"
+#include "core/arr.h"
 #include "core/ref.h"
 #include <stdlib.h>
 #include <float.h>
@@ -23,59 +24,393 @@ struct Model {
   struct Material** materials;
   NodeTransform* localTransforms;
   float* globalTransforms;
+  float* palettes;
+  uint32_t* paletteOffsets;
+  uint32_t* poses;
+  uint32_t* poseEpochs;
+  uint32_t* parents;
+  uint32_t* order;
+  uint32_t orderCount;
+  bool* nodesDirty;
+  bool* nodesMerged;
+  struct Mesh** staticMeshes;
+  uint32_t staticMeshCount;
   bool transformsDirty;
 };
 
-static void updateGlobalTransform(Model* model, uint32_t nodeIndex, mat4 parent) {
-  mat4 global = model->globalTransforms + 16 * nodeIndex;
-  NodeTransform* local = &model->localTransforms[nodeIndex];
-  vec3 T = local->properties[PROP_TRANSLATION];
-  quat R = local->properties[PROP_ROTATION];
-  vec3 S = local->properties[PROP_SCALE];
+// Lists the nodes reachable from the root so that every parent comes before its children, in the
+// same order a depth first traversal would visit them
+static void sortNodes(Model* model) {
+  ModelData* data = model->data;
+  uint32_t* stack = malloc(data->nodeCount * sizeof(uint32_t));
+  uint32_t stackSize = 0;
 
-  mat4_init(global, parent);
-  mat4_translate(global, T[0], T[1], T[2]);
-  mat4_rotateQuat(global, R);
-  mat4_scale(global, S[0], S[1], S[2]);
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    model->parents[i] = ~0u;
+  }
 
-  ModelNode* node = &model->data->nodes[nodeIndex];
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    updateGlobalTransform(model, node->children[i], global);
+  model->orderCount = 0;
+  stack[stackSize++] = data->rootNode;
+  while (stackSize > 0 && model->orderCount < data->nodeCount) {
+    uint32_t index = stack[--stackSize];
+    ModelNode* node = &data->nodes[index];
+    model->order[model->orderCount++] = index;
+
+    for (uint32_t i = node->childCount; i > 0 && stackSize < data->nodeCount; i--) {
+      uint32_t child = node->children[i - 1];
+      model->parents[child] = index;
+      stack[stackSize++] = child;
+    }
   }
+
+  free(stack);
 }
 
-static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
-  ModelNode* node = &model->data->nodes[nodeIndex];
-  mat4 globalTransform = model->globalTransforms + 16 * nodeIndex;
-  float poseMatrix[16 * MAX_BONES];
-  float* pose = NULL;
+// Only the nodes that were posed since the last update (and their descendants) are recomputed.  A
+// skin's palette is rebuilt when its node or any of its joints moved, and is then shared by every
+// draw of the Model until the pose changes again.  Palettes are uploaded to the pose stream lazily
+// when drawn, and the upload is reused until the palette changes or the stream wraps around.
+static void updateTransforms(Model* model) {
+  if (!model->transformsDirty) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < model->orderCount; i++) {
+    uint32_t index = model->order[i];
+    uint32_t parent = model->parents[index];
+
+    if (parent != ~0u && model->nodesDirty[parent]) {
+      model->nodesDirty[index] = true;
+    }
+
+    if (model->nodesDirty[index]) {
+      mat4 global = model->globalTransforms + 16 * index;
+      NodeTransform* local = &model->localTransforms[index];
+      vec3 T = local->properties[PROP_TRANSLATION];
+      quat R = local->properties[PROP_ROTATION];
+      vec3 S = local->properties[PROP_SCALE];
+
+      if (parent == ~0u) {
+        mat4_identity(global);
+      } else {
+        mat4_init(global, model->globalTransforms + 16 * parent);
+      }
+
+      mat4_translate(global, T[0], T[1], T[2]);
+      mat4_rotateQuat(global, R);
+      mat4_scale(global, S[0], S[1], S[2]);
+    }
+  }
+
+  for (uint32_t i = 0; i < model->orderCount; i++) {
+    uint32_t index = model->order[i];
+    ModelNode* node = &model->data->nodes[index];
+
+    if (node->skin == ~0u) {
+      continue;
+    }
 
-  if (node->skin != ~0u) {
     ModelSkin* skin = &model->data->skins[node->skin];
-    pose = poseMatrix;
+    bool dirty = model->nodesDirty[index];
+    for (uint32_t j = 0; j < skin->jointCount && !dirty; j++) {
+      dirty = model->nodesDirty[skin->joints[j]];
+    }
+
+    if (!dirty) {
+      continue;
+    }
 
+    float inverse[16];
+    mat4_init(inverse, model->globalTransforms + 16 * index);
+    mat4_invert(inverse);
+
+    float* palette = model->palettes + model->paletteOffsets[index];
     for (uint32_t j = 0; j < skin->jointCount; j++) {
       mat4 globalJointTransform = model->globalTransforms + 16 * skin->joints[j];
       mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
-      mat4 jointPose = pose + 16 * j;
+      mat4 jointPose = palette + 16 * j;
 
-      mat4_set(jointPose, globalTransform);
-      mat4_invert(jointPose);
+      mat4_init(jointPose, inverse);
       mat4_multiply(jointPose, globalJointTransform);
       mat4_multiply(jointPose, inverseBindMatrix);
     }
+
+    model->poseEpochs[index] = 0;
   }
 
-  for (uint32_t i = 0; i < node->primitiveCount; i++) {
-    lovrGraphicsDrawMesh(model->meshes[node->primitiveIndex + i], globalTransform, instances, pose);
+  memset(model->nodesDirty, 0, model->data->nodeCount * sizeof(bool));
+  model->transformsDirty = false;
+}
+
+// Bounds come from the accessor min/max when available, otherwise the positions are scanned
+static bool getPrimitiveBounds(ModelData* data, ModelPrimitive* primitive, float bounds[6]) {
+  ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+
+  if (!position || position->count == 0) {
+    return false;
+  }
+
+  if (position->hasMin && position->hasMax) {
+    bounds[0] = position->min[0];
+    bounds[1] = position->max[0];
+    bounds[2] = position->min[1];
+    bounds[3] = position->max[1];
+    bounds[4] = position->min[2];
+    bounds[5] = position->max[2];
+    return true;
+  }
+
+  if (position->type != F32 || position->components < 3) {
+    return false;
+  }
+
+  ModelBuffer* buffer = &data->buffers[position->buffer];
+  size_t stride = buffer->stride ? buffer->stride : position->components * sizeof(float);
+  char* cursor = buffer->data + position->offset;
+
+  bounds[0] = bounds[2] = bounds[4] = FLT_MAX;
+  bounds[1] = bounds[3] = bounds[5] = -FLT_MAX;
+
+  for (uint32_t i = 0; i < position->count; i++, cursor += stride) {
+    float* v = (float*) cursor;
+    bounds[0] = MIN(bounds[0], v[0]);
+    bounds[1] = MAX(bounds[1], v[0]);
+    bounds[2] = MIN(bounds[2], v[1]);
+    bounds[3] = MAX(bounds[3], v[1]);
+    bounds[4] = MIN(bounds[4], v[2]);
+    bounds[5] = MAX(bounds[5], v[2]);
+  }
+
+  return true;
+}
+
+// Merged geometry uses the same vertex format as the streaming buffers: position, normal, uv
+static bool canMerge(ModelData* data, ModelPrimitive* primitive) {
+  if (primitive->mode != DRAW_TRIANGLES && primitive->mode != DRAW_LINES && primitive->mode != DRAW_POINTS) {
+    return false;
+  }
+
+  ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+  ModelAttribute* normal = primitive->attributes[ATTR_NORMAL];
+  ModelAttribute* texCoord = primitive->attributes[ATTR_TEXCOORD];
+
+  if (!position || position->type != F32 || position->components != 3) return false;
+  if (normal && (normal->type != F32 || normal->components != 3)) return false;
+  if (texCoord && (texCoord->type != F32 || texCoord->components != 2)) return false;
+
+  for (uint32_t i = ATTR_COLOR; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+    if (primitive->attributes[i]) {
+      return false;
+    }
+  }
+
+  if (primitive->indices && primitive->indices->type != U8 && primitive->indices->type != U16 && primitive->indices->type != U32) {
+    return false;
+  }
+
+  return true;
+}
+
+static float* getAttributeElement(ModelData* data, ModelAttribute* attribute, uint32_t index) {
+  ModelBuffer* buffer = &data->buffers[attribute->buffer];
+  size_t stride = buffer->stride ? buffer->stride : attribute->components * sizeof(float);
+  return (float*) (buffer->data + attribute->offset + index * stride);
+}
+
+// A node is static if nothing can move it at runtime (other than lovrModelPose).  Animated nodes,
+// skin joints, skinned nodes, and all of their descendants are not static.
+static void findStaticNodes(Model* model, bool* result) {
+  ModelData* data = model->data;
+  bool* moving = calloc(data->nodeCount, sizeof(bool));
+
+  for (uint32_t i = 0; i < data->animationCount; i++) {
+    for (uint32_t j = 0; j < data->animations[i].channelCount; j++) {
+      moving[data->animations[i].channels[j].nodeIndex] = true;
+    }
+  }
+
+  for (uint32_t i = 0; i < data->skinCount; i++) {
+    for (uint32_t j = 0; j < data->skins[i].jointCount; j++) {
+      moving[data->skins[i].joints[j]] = true;
+    }
+  }
+
+  for (uint32_t i = 0; i < model->orderCount; i++) {
+    uint32_t index = model->order[i];
+    uint32_t parent = model->parents[index];
+    ModelNode* node = &data->nodes[index];
+    moving[index] |= node->skin != ~0u || (parent != ~0u && moving[parent]);
+
+    bool mergeable = !moving[index] && node->primitiveCount > 0;
+    for (uint32_t j = 0; j < node->primitiveCount && mergeable; j++) {
+      mergeable = canMerge(data, &data->primitives[node->primitiveIndex + j]);
+    }
+
+    result[index] = mergeable;
+  }
+
+  free(moving);
+}
+
+typedef struct {
+  uint32_t material;
+  DrawMode mode;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  float* vertices;
+  uint32_t* indices;
+  float bounds[6];
+} MergeGroup;
+
+// Pretransforms the primitives of static nodes into model space and concatenates the ones with the
+// same material and draw mode into a single Mesh
+static void mergeNodes(Model* model) {
+  ModelData* data = model->data;
+  arr_t(MergeGroup) groups;
+  arr_init(&groups);
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t i = 0; i < data->nodeCount; i++) {
+      if (!model->nodesMerged[i]) {
+        continue;
+      }
+
+      ModelNode* node = &data->nodes[i];
+      mat4 transform = model->globalTransforms + 16 * i;
+      float normalMatrix[16];
+      mat4_init(normalMatrix, transform);
+      mat4_invert(normalMatrix);
+      mat4_transpose(normalMatrix);
+
+      for (uint32_t j = 0; j < node->primitiveCount; j++) {
+        ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+        ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+        ModelAttribute* normal = primitive->attributes[ATTR_NORMAL];
+        ModelAttribute* texCoord = primitive->attributes[ATTR_TEXCOORD];
+        uint32_t vertexCount = position->count;
+        uint32_t indexCount = primitive->indices ? primitive->indices->count : vertexCount;
+
+        MergeGroup* group = NULL;
+        for (size_t k = 0; k < groups.length; k++) {
+          if (groups.data[k].material == primitive->material && groups.data[k].mode == primitive->mode) {
+            group = &groups.data[k];
+            break;
+          }
+        }
+
+        if (pass == 0) {
+          if (!group) {
+            arr_push(&groups, ((MergeGroup) { .material = primitive->material, .mode = primitive->mode }));
+            group = &groups.data[groups.length - 1];
+          }
+
+          group->vertexCount += vertexCount;
+          group->indexCount += indexCount;
+          continue;
+        }
+
+        uint32_t baseVertex = group->vertexCount;
+        float* vertex = group->vertices + 8 * baseVertex;
+        for (uint32_t k = 0; k < vertexCount; k++, vertex += 8) {
+          vec3_init(vertex, getAttributeElement(data, position, k));
+          mat4_transform(transform, vertex);
+
+          if (normal) {
+            vec3_init(vertex + 3, getAttributeElement(data, normal, k));
+            mat4_transformDirection(normalMatrix, vertex + 3);
+            vec3_normalize(vertex + 3);
+          } else {
+            vec3_set(vertex + 3, 0.f, 0.f, 0.f);
+          }
+
+          if (texCoord) {
+            memcpy(vertex + 6, getAttributeElement(data, texCoord, k), 2 * sizeof(float));
+          } else {
+            vertex[6] = vertex[7] = 0.f;
+          }
+
+          group->bounds[0] = MIN(group->bounds[0], vertex[0]);
+          group->bounds[1] = MAX(group->bounds[1], vertex[0]);
+          group->bounds[2] = MIN(group->bounds[2], vertex[1]);
+          group->bounds[3] = MAX(group->bounds[3], vertex[1]);
+          group->bounds[4] = MIN(group->bounds[4], vertex[2]);
+          group->bounds[5] = MAX(group->bounds[5], vertex[2]);
+        }
+
+        uint32_t* index = group->indices + group->indexCount;
+        if (primitive->indices) {
+          ModelAttribute* indices = primitive->indices;
+          char* source = data->buffers[indices->buffer].data + indices->offset;
+          for (uint32_t k = 0; k < indexCount; k++) {
+            switch (indices->type) {
+              case U8: index[k] = baseVertex + ((uint8_t*) source)[k]; break;
+              case U16: index[k] = baseVertex + ((uint16_t*) source)[k]; break;
+              default: index[k] = baseVertex + ((uint32_t*) source)[k]; break;
+            }
+          }
+        } else {
+          for (uint32_t k = 0; k < indexCount; k++) {
+            index[k] = baseVertex + k;
+          }
+        }
+
+        group->vertexCount += vertexCount;
+        group->indexCount += indexCount;
+      }
+    }
+
+    // After counting, allocate space for each group and rewind the counters for the second pass
+    if (pass == 0) {
+      for (size_t k = 0; k < groups.length; k++) {
+        MergeGroup* group = &groups.data[k];
+        group->vertices = malloc(8 * group->vertexCount * sizeof(float));
+        group->indices = malloc(group->indexCount * sizeof(uint32_t));
+        group->vertexCount = group->indexCount = 0;
+        group->bounds[0] = group->bounds[2] = group->bounds[4] = FLT_MAX;
+        group->bounds[1] = group->bounds[3] = group->bounds[5] = -FLT_MAX;
+      }
+    }
   }
 
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    renderNode(model, node->children[i], instances);
+  model->staticMeshCount = (uint32_t) groups.length;
+  model->staticMeshes = malloc(groups.length * sizeof(Mesh*));
+  for (size_t i = 0; i < groups.length; i++) {
+    MergeGroup* group = &groups.data[i];
+    size_t stride = 8 * sizeof(float);
+    Buffer* vertexBuffer = lovrBufferCreate(group->vertexCount * stride, group->vertices, BUFFER_VERTEX, USAGE_STATIC, false);
+    Buffer* indexBuffer = lovrBufferCreate(group->indexCount * sizeof(uint32_t), group->indices, BUFFER_INDEX, USAGE_STATIC, false);
+    Mesh* mesh = lovrMeshCreate(group->mode, NULL, 0);
+
+    lovrMeshAttachAttribute(mesh, "lovrPosition", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 });
+    lovrMeshAttachAttribute(mesh, "lovrNormal", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 });
+    lovrMeshAttachAttribute(mesh, "lovrTexCoord", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 });
+    lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) {
+      .buffer = lovrGraphicsGetIdentityBuffer(),
+      .type = U8,
+      .components = 1,
+      .divisor = 1,
+      .integer = true
+    });
+
+    lovrMeshSetIndexBuffer(mesh, indexBuffer, group->indexCount, sizeof(uint32_t), 0);
+    lovrMeshSetDrawRange(mesh, 0, group->indexCount);
+    lovrMeshSetBounds(mesh, group->bounds);
+
+    if (group->material != ~0u) {
+      lovrMeshSetMaterial(mesh, model->materials[group->material]);
+    }
+
+    model->staticMeshes[i] = mesh;
+    lovrRelease(Buffer, vertexBuffer);
+    lovrRelease(Buffer, indexBuffer);
+    free(group->vertices);
+    free(group->indices);
   }
+
+  arr_free(&groups);
 }
 
-Model* lovrModelCreate(ModelData* data) {
+Model* lovrModelCreate(ModelData* data, bool staticBatching) {
   Model* model = lovrAlloc(Model);
   model->data = data;
   lovrRetain(data);
@@ -119,6 +454,56 @@ Model* lovrModelCreate(ModelData* data) {
     }
   }
 
+  // Transforms
+  model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
+  model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
+  model->parents = malloc(data->nodeCount * sizeof(uint32_t));
+  model->order = malloc(data->nodeCount * sizeof(uint32_t));
+  model->nodesDirty = calloc(data->nodeCount, sizeof(bool));
+  model->paletteOffsets = malloc(data->nodeCount * sizeof(uint32_t));
+  model->poses = malloc(data->nodeCount * sizeof(uint32_t));
+  model->poseEpochs = calloc(data->nodeCount, sizeof(uint32_t));
+  sortNodes(model);
+
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    mat4_identity(model->globalTransforms + 16 * i);
+  }
+
+  // Each skinned node gets its own palette
+  uint32_t paletteSize = 0;
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    if (data->nodes[i].skin != ~0u) {
+      model->paletteOffsets[i] = paletteSize;
+      paletteSize += 16 * data->skins[data->nodes[i].skin].jointCount;
+    } else {
+      model->paletteOffsets[i] = ~0u;
+    }
+  }
+
+  if (paletteSize > 0) {
+    model->palettes = malloc(paletteSize * sizeof(float));
+    for (uint32_t i = 0; i < paletteSize; i += 16) {
+      mat4_identity(model->palettes + i);
+    }
+  }
+
+  lovrModelResetPose(model);
+  updateTransforms(model);
+
+  // Static batching has to know which primitives still need to be drawn individually
+  bool* needed = NULL;
+  if (staticBatching) {
+    model->nodesMerged = calloc(data->nodeCount, sizeof(bool));
+    needed = calloc(data->primitiveCount, sizeof(bool));
+    findStaticNodes(model, model->nodesMerged);
+
+    for (uint32_t i = 0; i < data->nodeCount; i++) {
+      for (uint32_t j = 0; j < data->nodes[i].primitiveCount && !model->nodesMerged[i]; j++) {
+        needed[data->nodes[i].primitiveIndex + j] = true;
+      }
+    }
+  }
+
   // Geometry
   if (data->primitiveCount > 0) {
     if (data->bufferCount > 0) {
@@ -127,6 +512,10 @@ Model* lovrModelCreate(ModelData* data) {
 
     model->meshes = calloc(data->primitiveCount, sizeof(Mesh*));
     for (uint32_t i = 0; i < data->primitiveCount; i++) {
+      if (needed && !needed[i]) {
+        continue;
+      }
+
       ModelPrimitive* primitive = &data->primitives[i];
       model->meshes[i] = lovrMeshCreate(primitive->mode, NULL, 0);
 
@@ -134,6 +523,11 @@ Model* lovrModelCreate(ModelData* data) {
         lovrMeshSetMaterial(model->meshes[i], model->materials[primitive->material]);
       }
 
+      float bounds[6];
+      if (getPrimitiveBounds(data, primitive, bounds)) {
+        lovrMeshSetBounds(model->meshes[i], bounds);
+      }
+
       bool setDrawRange = false;
       for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
         if (primitive->attributes[j]) {
@@ -184,9 +578,13 @@ Model* lovrModelCreate(ModelData* data) {
     }
   }
 
-  model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
-  model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
-  lovrModelResetPose(model);
+  free(needed);
+
+  // Static batching
+  if (model->nodesMerged) {
+    mergeNodes(model);
+  }
+
   return model;
 }
 
@@ -207,6 +605,10 @@ void lovrModelDestroy(void* ref) {
     free(model->meshes);
   }
 
+  for (uint32_t i = 0; i < model->staticMeshCount; i++) {
+    lovrRelease(Mesh, model->staticMeshes[i]);
+  }
+
   if (model->textures) {
     for (uint32_t i = 0; i < model->data->textureCount; i++) {
       lovrRelease(Texture, model->textures[i]);
@@ -224,6 +626,15 @@ void lovrModelDestroy(void* ref) {
   lovrRelease(ModelData, model->data);
   free(model->globalTransforms);
   free(model->localTransforms);
+  free(model->palettes);
+  free(model->paletteOffsets);
+  free(model->poses);
+  free(model->poseEpochs);
+  free(model->parents);
+  free(model->order);
+  free(model->nodesDirty);
+  free(model->nodesMerged);
+  free(model->staticMeshes);
 }
 
 ModelData* lovrModelGetModelData(Model* model) {
@@ -231,14 +642,41 @@ ModelData* lovrModelGetModelData(Model* model) {
 }
 
 void lovrModelDraw(Model* model, mat4 transform, uint32_t instances) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
+  updateTransforms(model);
 
   lovrGraphicsPush();
   lovrGraphicsMatrixTransform(transform);
-  renderNode(model, model->data->rootNode, instances);
+
+  for (uint32_t i = 0; i < model->staticMeshCount; i++) {
+    lovrGraphicsDrawMesh(model->staticMeshes[i], (float[]) MAT4_IDENTITY, instances, ~0u);
+  }
+
+  for (uint32_t i = 0; i < model->orderCount; i++) {
+    uint32_t index = model->order[i];
+    ModelNode* node = &model->data->nodes[index];
+
+    if (model->nodesMerged && model->nodesMerged[index]) {
+      continue;
+    }
+
+    mat4 globalTransform = model->globalTransforms + 16 * index;
+    uint32_t pose = ~0u;
+
+    if (node->skin != ~0u && node->primitiveCount > 0) {
+      if (model->poseEpochs[index] != lovrGraphicsGetPoseEpoch()) {
+        uint32_t jointCount = model->data->skins[node->skin].jointCount;
+        model->poses[index] = lovrGraphicsUploadPose(model->palettes + model->paletteOffsets[index], jointCount);
+        model->poseEpochs[index] = lovrGraphicsGetPoseEpoch();
+      }
+
+      pose = model->poses[index];
+    }
+
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      lovrGraphicsDrawMesh(model->meshes[node->primitiveIndex + j], globalTransform, instances, pose);
+    }
+  }
+
   lovrGraphicsPop();
 }
 
@@ -316,6 +754,8 @@ void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float a
     } else {
       lerp(transform->properties[channel->property], property, alpha);
     }
+
+    model->nodesDirty[nodeIndex] = true;
   }
 
   model->transformsDirty = true;
@@ -327,11 +767,7 @@ void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], f
     vec3_init(position, model->localTransforms[nodeIndex].properties[PROP_TRANSLATION]);
     quat_init(rotation, model->localTransforms[nodeIndex].properties[PROP_ROTATION]);
   } else {
-    if (model->transformsDirty) {
-      updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-      model->transformsDirty = false;
-    }
-
+    updateTransforms(model);
     mat4_getPosition(model->globalTransforms + 16 * nodeIndex, position);
     mat4_getOrientation(model->globalTransforms + 16 * nodeIndex, rotation);
   }
@@ -351,6 +787,7 @@ void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float ro
     vec3_lerp(transform->properties[PROP_TRANSLATION], position, alpha);
     quat_slerp(transform->properties[PROP_ROTATION], rotation, alpha);
   }
+  model->nodesDirty[nodeIndex] = true;
   model->transformsDirty = true;
 }
 
@@ -365,6 +802,8 @@ void lovrModelResetPose(Model* model) {
       quat_init(model->localTransforms[i].properties[PROP_ROTATION], model->data->nodes[i].rotation);
       vec3_init(model->localTransforms[i].properties[PROP_SCALE], model->data->nodes[i].scale);
     }
+
+    model->nodesDirty[i] = true;
   }
 
   model->transformsDirty = true;
@@ -412,19 +851,13 @@ static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
       aabb[5] = MAX(aabb[5], max[2]);
     }
   }
-
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    applyAABB(model, node->children[i], aabb);
-  }
 }
 
 void lovrModelGetAABB(Model* model, float aabb[6]) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
-
+  updateTransforms(model);
   aabb[0] = aabb[2] = aabb[4] = FLT_MAX;
   aabb[1] = aabb[3] = aabb[5] = -FLT_MAX;
-  applyAABB(model, model->data->rootNode, aabb);
+  for (uint32_t i = 0; i < model->orderCount; i++) {
+    applyAABB(model, model->order[i], aabb);
+  }
 }
@@ -12,7 +12,7 @@ typedef enum {
 } CoordinateSpace;
 
 typedef struct Model Model;
-Model* lovrModelCreate(struct ModelData* data);
+Model* lovrModelCreate(struct ModelData* data, bool staticBatching);
 void lovrModelDestroy(void* ref);
 struct ModelData* lovrModelGetModelData(Model* model);
 void lovrModelDraw(Model* model, float* transform, uint32_t instances);
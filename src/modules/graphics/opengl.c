@@ -464,6 +464,22 @@ static void lovrGpuSync(uint8_t flags) {
 }
 #endif
 
+// Waits for the GPU to finish with a region of a streaming buffer
+#ifndef LOVR_WEBGL
+static void lovrGpuWaitFence(GLsync fence) {
+  GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+  if (status == GL_TIMEOUT_EXPIRED) {
+    state.stats.fenceWaits++;
+    do {
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (status == GL_TIMEOUT_EXPIRED);
+  }
+
+  glDeleteSync(fence);
+}
+#endif
+
 static void lovrGpuDestroySyncResource(void* resource, uint8_t incoherent) {
   if (!incoherent) {
     return;
@@ -552,6 +568,7 @@ static void lovrGpuBindTexture(Texture* texture, int slot) {
       state.activeTexture = slot;
     }
     glBindTexture(texture->target, texture->id);
+    state.stats.textureBinds++;
   }
 }
 
@@ -612,9 +629,10 @@ static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
       mesh->divisors[location] = divisor;
     }
 
-    if (mesh->locations[location] == i) { continue; }
+    if (mesh->locations[location] == i && mesh->buffers[location] == attribute->buffer->id) { continue; }
 
     mesh->locations[location] = i;
+    mesh->buffers[location] = attribute->buffer->id;
     lovrGpuBindBuffer(BUFFER_VERTEX, attribute->buffer->id);
     GLenum type = convertAttributeType(attribute->type);
     GLvoid* offset = (GLvoid*) (intptr_t) attribute->offset;
@@ -715,6 +733,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Alpha Coverage
   if (state.alphaToCoverage != pipeline->alphaSampling) {
+    state.stats.pipelineChanges++;
     state.alphaToCoverage = pipeline->alphaSampling;
     if (state.alphaToCoverage) {
       glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
@@ -725,6 +744,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Blend mode
   if (state.blendMode != pipeline->blendMode || state.blendAlphaMode != pipeline->blendAlphaMode) {
+    state.stats.pipelineChanges++;
     state.blendMode = pipeline->blendMode;
     state.blendAlphaMode = pipeline->blendAlphaMode;
 
@@ -787,12 +807,14 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Color mask
   if (state.colorMask != pipeline->colorMask) {
+    state.stats.pipelineChanges++;
     state.colorMask = pipeline->colorMask;
     glColorMask(state.colorMask & 0x8, state.colorMask & 0x4, state.colorMask & 0x2, state.colorMask & 0x1);
   }
 
   // Culling
   if (state.culling != pipeline->culling) {
+    state.stats.pipelineChanges++;
     state.culling = pipeline->culling;
     if (state.culling) {
       glEnable(GL_CULL_FACE);
@@ -803,6 +825,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Depth test
   if (state.depthTest != pipeline->depthTest) {
+    state.stats.pipelineChanges++;
     state.depthTest = pipeline->depthTest;
     if (state.depthTest != COMPARE_NONE) {
       if (!state.depthEnabled) {
@@ -818,18 +841,21 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Depth write
   if (state.depthWrite != (pipeline->depthWrite && !state.stencilWriting)) {
+    state.stats.pipelineChanges++;
     state.depthWrite = pipeline->depthWrite && !state.stencilWriting;
     glDepthMask(state.depthWrite);
   }
 
   // Line width
   if (state.lineWidth != pipeline->lineWidth) {
+    state.stats.pipelineChanges++;
     state.lineWidth = pipeline->lineWidth;
     glLineWidth(state.lineWidth);
   }
 
   // Stencil mode
   if (!state.stencilWriting && (state.stencilMode != pipeline->stencilMode || state.stencilValue != pipeline->stencilValue)) {
+    state.stats.pipelineChanges++;
     state.stencilMode = pipeline->stencilMode;
     state.stencilValue = pipeline->stencilValue;
     if (state.stencilMode != COMPARE_NONE) {
@@ -859,6 +885,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 
   // Winding
   if (state.winding != pipeline->winding) {
+    state.stats.pipelineChanges++;
     state.winding = pipeline->winding;
     glFrontFace(state.winding == WINDING_CLOCKWISE ? GL_CW : GL_CCW);
   }
@@ -866,6 +893,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   // Wireframe
 #ifdef LOVR_GL
   if (state.wireframe != pipeline->wireframe) {
+    state.stats.pipelineChanges++;
     state.wireframe = pipeline->wireframe;
     glPolygonMode(GL_FRONT_AND_BACK, state.wireframe ? GL_LINE : GL_FILL);
   }
@@ -1398,7 +1426,7 @@ const GpuLimits* lovrGpuGetLimits() {
   return &state.limits;
 }
 
-const GpuStats* lovrGpuGetStats() {
+GpuStats* lovrGpuGetStats() {
   return &state.stats;
 }
 
@@ -1827,9 +1855,18 @@ Buffer* lovrBufferInit(Buffer* buffer, size_t size, void* data, BufferType type,
 void lovrBufferDestroy(void* ref) {
   Buffer* buffer = ref;
   lovrGpuDestroySyncResource(buffer, buffer->incoherent);
-  glDeleteBuffers(1, &buffer->id);
 #ifdef LOVR_WEBGL
+  glDeleteBuffers(1, &buffer->id);
   free(buffer->data);
+#else
+  if (buffer->ring[0]) {
+    for (int i = 0; i < BUFFER_RING_SIZE; i++) {
+      if (buffer->fences[i]) glDeleteSync(buffer->fences[i]);
+      if (buffer->ring[i]) glDeleteBuffers(1, &buffer->ring[i]);
+    }
+  } else {
+    glDeleteBuffers(1, &buffer->id);
+  }
 #endif
 }
 
@@ -1877,6 +1914,40 @@ void lovrBufferUnmap(Buffer* buffer) {
 }
 
 void lovrBufferDiscard(Buffer* buffer) {
+#ifndef LOVR_WEBGL
+  // Persistently mapped streaming buffers are never orphaned.  Instead, they rotate through a ring
+  // of buffers that are created as needed.  Each one is fenced when it's given up and the fence is
+  // waited on before it gets written to again.
+  if (GLAD_GL_ARB_buffer_storage && buffer->usage == USAGE_STREAM && !buffer->readable) {
+    if (!buffer->ring[0]) {
+      buffer->ring[0] = buffer->id;
+      buffer->ringData[0] = buffer->data;
+    }
+
+    buffer->fences[buffer->ringIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer->ringIndex = (buffer->ringIndex + 1) % BUFFER_RING_SIZE;
+    uint8_t index = buffer->ringIndex;
+
+    if (buffer->fences[index]) {
+      lovrGpuWaitFence(buffer->fences[index]);
+      buffer->fences[index] = NULL;
+    }
+
+    if (!buffer->ring[index]) {
+      GLenum glType = convertBufferType(buffer->type);
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+      glGenBuffers(1, &buffer->ring[index]);
+      lovrGpuBindBuffer(buffer->type, buffer->ring[index]);
+      glBufferStorage(glType, buffer->size, NULL, flags);
+      buffer->ringData[index] = glMapBufferRange(glType, 0, buffer->size, flags | GL_MAP_FLUSH_EXPLICIT_BIT);
+    }
+
+    buffer->id = buffer->ring[index];
+    buffer->data = buffer->ringData[index];
+    return;
+  }
+#endif
+
   lovrGpuBindBuffer(buffer->type, buffer->id);
   GLenum glType = convertBufferType(buffer->type);
 #ifdef LOVR_WEBGL
@@ -11,9 +11,15 @@
 
 #pragma once
 
+#define BUFFER_RING_SIZE 3
+
 #define GPU_BUFFER_FIELDS \
   uint8_t incoherent; \
-  uint32_t id;
+  uint32_t id; \
+  uint32_t ring[BUFFER_RING_SIZE]; \
+  void* ringData[BUFFER_RING_SIZE]; \
+  GLsync fences[BUFFER_RING_SIZE]; \
+  uint8_t ringIndex;
 
 #define GPU_CANVAS_FIELDS \
   bool immortal; \
@@ -23,7 +29,8 @@
 
 #define GPU_MESH_FIELDS \
   uint32_t vao; \
-  uint32_t ibo;
+  uint32_t ibo; \
+  uint32_t buffers[MAX_ATTRIBUTES];
 
 #define GPU_SHADER_FIELDS \
   uint32_t program;
@@ -21,7 +21,7 @@ void lovrPoolDestroy(void* ref) {
 }
 
 void lovrPoolGrow(Pool* pool, size_t count) {
-  lovrAssert(count <= (1 << 16), "Temporary vector space exhausted.  Try using lovr.math.drain to drain the vector pool periodically.");
+  lovrAssert(count <= POOL_MAX_SIZE, "Temporary vector space exhausted.  Try using lovr.math.drain to drain the vector pool periodically.");
   pool->count = count;
   pool->data = realloc(pool->data, pool->count * sizeof(float));
   lovrAssert(pool->data, "Out of memory");
@@ -37,8 +37,8 @@ Vector lovrPoolAllocate(Pool* pool, VectorType type, float** data) {
   Vector v = {
     .handle = {
       .type = type,
-      .generation = (uint8_t) pool->generation,
-      .index = (uint16_t) pool->cursor
+      .generation = pool->generation,
+      .index = pool->cursor
     }
   };
 
@@ -54,5 +54,5 @@ float* lovrPoolResolve(Pool* pool, Vector vector) {
 
 void lovrPoolDrain(Pool* pool) {
   pool->cursor = 0;
-  pool->generation = (pool->generation + 1) & 0xff;
+  pool->generation = (pool->generation + 1) & ((1 << POOL_GENERATION_BITS) - 1);
 }
@@ -13,15 +13,33 @@ typedef enum {
   MAX_VECTOR_TYPES
 } VectorType;
 
+// Temporary vectors are passed to Lua as light userdata that packs the type, generation, and float
+// offset into the bits of the pointer.  LuaJIT only accepts light userdata in the low 39 bits of
+// the address space without allocating extra segments, and 32 bit platforms have even less room.
+#if UINTPTR_MAX > 0xffffffff
+#define POOL_GENERATION_BITS 8
+#define POOL_MAX_SIZE (1 << 27)
 typedef union {
   void* pointer;
   struct {
-    uint8_t type;
-    uint8_t generation;
-    uint16_t index;
-    uint32_t padding;
+    uint64_t type : 4;
+    uint64_t generation : POOL_GENERATION_BITS;
+    uint64_t index : 27;
+    uint64_t padding : 25;
   } handle;
 } Vector;
+#else
+#define POOL_GENERATION_BITS 4
+#define POOL_MAX_SIZE (1 << 24)
+typedef union {
+  void* pointer;
+  struct {
+    uint32_t type : 4;
+    uint32_t generation : POOL_GENERATION_BITS;
+    uint32_t index : 24;
+  } handle;
+} Vector;
+#endif
 
 typedef struct Pool {
   float* data;
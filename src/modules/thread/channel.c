@@ -1,4 +1,5 @@
 #include "thread/channel.h"
+#include "core/atomic.h"
 #include "event/event.h"
 #include "core/arr.h"
 #include "core/ref.h"
@@ -6,8 +7,14 @@
 #include "lib/tinycthread/tinycthread.h"
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <math.h>
 
+typedef struct {
+  atomic64 sequence;
+  Variant value;
+} Cell;
+
 struct Channel {
   mtx_t lock;
   cnd_t cond;
@@ -16,35 +23,230 @@ struct Channel {
   uint64_t sent;
   uint64_t received;
   uint64_t hash;
+  uint32_t capacity;
+  uint64_t mask;
+  Cell* cells;
+  char padding1[64];
+  atomic64 enqueue;
+  char padding2[64];
+  atomic64 dequeue;
+  char padding3[64];
+  atomic64 popped;
+  atomic64 waiters;
+  atomic64 selectorCount;
+  arr_t(struct Selector*) selectors;
 };
 
-Channel* lovrChannelCreate(uint64_t hash) {
+// lovrChannelSelect registers one of these on every Channel it's waiting on, and pushes signal it
+typedef struct Selector {
+  mtx_t lock;
+  cnd_t cond;
+  bool signaled;
+} Selector;
+
+static void waitFor(cnd_t* cond, mtx_t* lock, double* timeout) {
+  if (isinf(*timeout)) {
+    cnd_wait(cond, lock);
+  } else {
+    struct timespec start;
+    struct timespec until;
+    struct timespec stop;
+    timespec_get(&start, TIME_UTC);
+    double whole, fraction;
+    fraction = modf(*timeout, &whole);
+    until.tv_sec = start.tv_sec + whole;
+    until.tv_nsec = start.tv_nsec + fraction * 1e9;
+    if (until.tv_nsec >= 1000000000) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000;
+    }
+    cnd_timedwait(cond, lock, &until);
+    timespec_get(&stop, TIME_UTC);
+    *timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  }
+}
+
+static void lovrChannelWait(Channel* channel, double* timeout) {
+  waitFor(&channel->cond, &channel->lock, timeout);
+}
+
+// Signals any selectors waiting on the Channel, the Channel must be locked
+static void lovrChannelNotify(Channel* channel) {
+  for (size_t i = 0; i < channel->selectors.length; i++) {
+    Selector* selector = channel->selectors.data[i];
+    mtx_lock(&selector->lock);
+    selector->signaled = true;
+    cnd_signal(&selector->cond);
+    mtx_unlock(&selector->lock);
+  }
+}
+
+// Bounded channels use a lock-free ring (Dmitry Vyukov's MPMC queue).  Each cell has a sequence
+// number that tells producers and consumers whose turn it is.  The lock and condition variable are
+// only used to park threads when the ring is full or empty, and are only touched by the other side
+// when something is actually parked.
+
+static bool lovrChannelTryPush(Channel* channel, Variant* variant, uint64_t* id) {
+  uint64_t position = atomic_load64(&channel->enqueue);
+  Cell* cell;
+
+  for (;;) {
+    cell = &channel->cells[position & channel->mask];
+    int64_t difference = (int64_t) (atomic_load64(&cell->sequence) - position);
+    if (difference == 0) {
+      if (atomic_cas64(&channel->enqueue, &position, position + 1)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = atomic_load64(&channel->enqueue);
+    }
+  }
+
+  cell->value = *variant;
+  atomic_store64(&cell->sequence, position + 1);
+  *id = position + 1;
+  return true;
+}
+
+static bool lovrChannelTryPop(Channel* channel, Variant* variant) {
+  uint64_t position = atomic_load64(&channel->dequeue);
+  Cell* cell;
+
+  for (;;) {
+    cell = &channel->cells[position & channel->mask];
+    int64_t difference = (int64_t) (atomic_load64(&cell->sequence) - (position + 1));
+    if (difference == 0) {
+      if (atomic_cas64(&channel->dequeue, &position, position + 1)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = atomic_load64(&channel->dequeue);
+    }
+  }
+
+  *variant = cell->value;
+  atomic_store64(&cell->sequence, position + channel->mask + 1);
+  atomic_add64(&channel->popped, 1);
+  return true;
+}
+
+static bool lovrChannelIsReady(Channel* channel, bool push) {
+  uint64_t position = atomic_load64(push ? &channel->enqueue : &channel->dequeue);
+  uint64_t sequence = atomic_load64(&channel->cells[position & channel->mask].sequence);
+  return (int64_t) (sequence - (position + !push)) >= 0;
+}
+
+// Waits until the ring might have room (or messages), returning false once the timeout is used up.
+// The waiter count is bumped before checking the ring under the lock, so a wakeup can't be missed.
+static bool lovrChannelPark(Channel* channel, bool push, double* timeout) {
+  if (isnan(*timeout) || *timeout < 0) {
+    return false;
+  }
+
+  atomic_add64(&channel->waiters, 1);
+  mtx_lock(&channel->lock);
+  if (!lovrChannelIsReady(channel, push)) {
+    lovrChannelWait(channel, timeout);
+  }
+  mtx_unlock(&channel->lock);
+  atomic_add64(&channel->waiters, -1);
+  return true;
+}
+
+static void lovrChannelWake(Channel* channel) {
+  if (atomic_add64(&channel->waiters, 0) > 0) {
+    mtx_lock(&channel->lock);
+    cnd_broadcast(&channel->cond);
+    mtx_unlock(&channel->lock);
+  }
+}
+
+Channel* lovrChannelCreate(uint64_t hash, uint32_t capacity) {
   Channel* channel = lovrAlloc(Channel);
   arr_init(&channel->messages);
+  arr_init(&channel->selectors);
   mtx_init(&channel->lock, mtx_plain | mtx_timed);
   cnd_init(&channel->cond);
   channel->hash = hash;
+
+  if (capacity > 0) {
+    lovrAssert(capacity <= (1u << 24), "Channel capacity can not be bigger than %d", 1 << 24);
+    uint32_t size = 2; // A ring with a single cell can't tell "full" from "empty"
+    while (size < capacity) size <<= 1;
+    channel->capacity = capacity;
+    channel->mask = size - 1;
+    channel->cells = malloc(size * sizeof(Cell));
+    lovrAssert(channel->cells, "Out of memory");
+    for (uint32_t i = 0; i < size; i++) {
+      channel->cells[i].sequence = i;
+    }
+  }
+
   return channel;
 }
 
-extern void lovrThreadRemoveChannel(uint64_t hash);
 void lovrChannelDestroy(void* ref) {
   Channel* channel = ref;
-  lovrThreadRemoveChannel(channel->hash);
   lovrChannelClear(channel);
   arr_free(&channel->messages);
+  arr_free(&channel->selectors);
+  free(channel->cells);
   mtx_destroy(&channel->lock);
   cnd_destroy(&channel->cond);
 }
 
+uint32_t lovrChannelGetCapacity(Channel* channel) {
+  return channel->capacity;
+}
+
 bool lovrChannelPush(Channel* channel, Variant* variant, double timeout, uint64_t* id) {
-  mtx_lock(&channel->lock);
-  if (channel->messages.length == 0) {
-    lovrRetain(channel);
+  uint32_t count = 1;
+  bool read = lovrChannelPushMany(channel, variant, &count, timeout, id);
+  return channel->capacity > 0 ? count == 1 : read;
+}
+
+// Pushes messages with a single lock (or a single wakeup, for bounded Channels).  For unbounded
+// Channels, this waits for the last message to be read, like lovrChannelPush.  Bounded Channels
+// wait for space instead, and count is set to the number of messages that fit before the timeout.
+bool lovrChannelPushMany(Channel* channel, Variant* variants, uint32_t* count, double timeout, uint64_t* id) {
+  if (channel->capacity > 0) {
+    uint32_t pushed = 0;
+    *id = 0;
+
+    do {
+      while (pushed < *count && lovrChannelTryPush(channel, &variants[pushed], id)) {
+        pushed++;
+      }
+
+      if (pushed > 0) {
+        lovrChannelWake(channel);
+
+        if (atomic_load64(&channel->selectorCount) > 0) {
+          mtx_lock(&channel->lock);
+          lovrChannelNotify(channel);
+          mtx_unlock(&channel->lock);
+        }
+      }
+
+      if (pushed == *count) {
+        return false;
+      }
+    } while (lovrChannelPark(channel, true, &timeout));
+
+    *count = pushed;
+    return false;
   }
-  arr_push(&channel->messages, *variant);
-  *id = ++channel->sent;
+
+  mtx_lock(&channel->lock);
+  arr_append(&channel->messages, variants, *count);
+  channel->sent += *count;
+  *id = channel->sent;
   cnd_broadcast(&channel->cond);
+  lovrChannelNotify(channel);
 
   if (isnan(timeout) || timeout < 0) {
     mtx_unlock(&channel->lock);
@@ -52,21 +254,7 @@ bool lovrChannelPush(Channel* channel, Variant* variant, double timeout, uint64_
   }
 
   while (channel->received < *id && timeout >= 0) {
-    if (isinf(timeout)) {
-      cnd_wait(&channel->cond, &channel->lock);
-    } else {
-      struct timespec start;
-      struct timespec until;
-      struct timespec stop;
-      timespec_get(&start, TIME_UTC);
-      double whole, fraction;
-      fraction = modf(timeout, &whole);
-      until.tv_sec = start.tv_sec + whole;
-      until.tv_nsec = start.tv_nsec + fraction * 1e9;
-      cnd_timedwait(&channel->cond, &channel->lock, &until);
-      timespec_get(&stop, TIME_UTC);
-      timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
-    }
+    lovrChannelWait(channel, &timeout);
   }
 
   bool read = channel->received >= *id;
@@ -75,43 +263,135 @@ bool lovrChannelPush(Channel* channel, Variant* variant, double timeout, uint64_
 }
 
 bool lovrChannelPop(Channel* channel, Variant* variant, double timeout) {
+  return lovrChannelPopMany(channel, variant, 1, timeout) == 1;
+}
+
+// Waits for at least one message, then takes up to max messages without waiting any longer
+uint32_t lovrChannelPopMany(Channel* channel, Variant* variants, uint32_t max, double timeout) {
+  if (max == 0) {
+    return 0;
+  }
+
+  if (channel->capacity > 0) {
+    do {
+      uint32_t popped = 0;
+      while (popped < max && lovrChannelTryPop(channel, &variants[popped])) {
+        popped++;
+      }
+
+      if (popped > 0) {
+        lovrChannelWake(channel);
+        return popped;
+      }
+    } while (lovrChannelPark(channel, false, &timeout));
+
+    return 0;
+  }
+
   mtx_lock(&channel->lock);
 
   do {
     if (channel->head < channel->messages.length) {
-      *variant = channel->messages.data[channel->head++];
+      size_t available = channel->messages.length - channel->head;
+      uint32_t popped = available < max ? (uint32_t) available : max;
+      memcpy(variants, channel->messages.data + channel->head, popped * sizeof(Variant));
+      channel->head += popped;
       if (channel->head == channel->messages.length) {
         channel->head = channel->messages.length = 0;
-        lovrRelease(Channel, channel);
       }
-      channel->received++;
+      channel->received += popped;
       cnd_broadcast(&channel->cond);
       mtx_unlock(&channel->lock);
-      return true;
+      return popped;
     } else if (isnan(timeout) || timeout < 0) {
       mtx_unlock(&channel->lock);
-      return false;
+      return 0;
     }
 
-    if (isinf(timeout)) {
-      cnd_wait(&channel->cond, &channel->lock);
-    } else {
-      struct timespec start;
-      struct timespec until;
-      struct timespec stop;
-      timespec_get(&start, TIME_UTC);
-      double whole, fraction;
-      fraction = modf(timeout, &whole);
-      until.tv_sec = start.tv_sec + whole;
-      until.tv_nsec = start.tv_nsec + fraction * 1e9;
-      cnd_timedwait(&channel->cond, &channel->lock, &until);
-      timespec_get(&stop, TIME_UTC);
-      timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / (double) 1e9;
-    }
+    lovrChannelWait(channel, &timeout);
   } while (1);
 }
 
+static void lovrChannelAddSelector(Channel* channel, Selector* selector) {
+  mtx_lock(&channel->lock);
+  arr_push(&channel->selectors, selector);
+  atomic_add64(&channel->selectorCount, 1);
+  mtx_unlock(&channel->lock);
+}
+
+static void lovrChannelRemoveSelector(Channel* channel, Selector* selector) {
+  mtx_lock(&channel->lock);
+  for (size_t i = 0; i < channel->selectors.length; i++) {
+    if (channel->selectors.data[i] == selector) {
+      arr_splice(&channel->selectors, i, 1);
+      atomic_add64(&channel->selectorCount, -1);
+      break;
+    }
+  }
+  mtx_unlock(&channel->lock);
+}
+
+// Pops a message from one of the Channels, waiting up to the timeout for one to arrive.  Returns
+// the index of the Channel, or -1 if the timeout expired.  Each call starts looking at a different
+// Channel, so a busy Channel early in the list can't starve the others.  Instead of polling, a
+// Selector is registered on each Channel, and checked again after registering so a message that
+// arrived in between isn't missed.
+int lovrChannelSelect(Channel** channels, uint32_t count, Variant* variant, double timeout) {
+  static LOVR_THREAD_LOCAL uint32_t rotation;
+  uint32_t offset = count > 0 ? rotation++ % count : 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t index = (offset + i) % count;
+    if (lovrChannelPop(channels[index], variant, NAN)) {
+      return index;
+    }
+  }
+
+  if (isnan(timeout) || timeout < 0) {
+    return -1;
+  }
+
+  Selector selector;
+  selector.signaled = false;
+  mtx_init(&selector.lock, mtx_plain | mtx_timed);
+  cnd_init(&selector.cond);
+
+  for (uint32_t i = 0; i < count; i++) {
+    lovrChannelAddSelector(channels[i], &selector);
+  }
+
+  int index = -1;
+  for (;;) {
+    for (uint32_t i = 0; i < count && index < 0; i++) {
+      uint32_t j = (offset + i) % count;
+      if (lovrChannelPop(channels[j], variant, NAN)) {
+        index = j;
+      }
+    }
+
+    if (index >= 0 || timeout < 0) {
+      break;
+    }
+
+    mtx_lock(&selector.lock);
+    if (!selector.signaled) {
+      waitFor(&selector.cond, &selector.lock, &timeout);
+    }
+    selector.signaled = false;
+    mtx_unlock(&selector.lock);
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    lovrChannelRemoveSelector(channels[i], &selector);
+  }
+
+  mtx_destroy(&selector.lock);
+  cnd_destroy(&selector.cond);
+  return index;
+}
+
 bool lovrChannelPeek(Channel* channel, Variant* variant) {
+  lovrAssert(channel->capacity == 0, "Bounded Channels can not be peeked, since another thread could pop the message at any time");
   mtx_lock(&channel->lock);
 
   if (channel->head < channel->messages.length) {
@@ -125,6 +405,15 @@ bool lovrChannelPeek(Channel* channel, Variant* variant) {
 }
 
 void lovrChannelClear(Channel* channel) {
+  if (channel->capacity > 0) {
+    Variant variant;
+    while (lovrChannelTryPop(channel, &variant)) {
+      lovrVariantDestroy(&variant);
+    }
+    lovrChannelWake(channel);
+    return;
+  }
+
   mtx_lock(&channel->lock);
   for (size_t i = channel->head; i < channel->messages.length; i++) {
     lovrVariantDestroy(&channel->messages.data[i]);
@@ -137,6 +426,12 @@ void lovrChannelClear(Channel* channel) {
 }
 
 uint64_t lovrChannelGetCount(Channel* channel) {
+  if (channel->capacity > 0) {
+    uint64_t dequeue = atomic_load64(&channel->dequeue);
+    uint64_t enqueue = atomic_load64(&channel->enqueue);
+    return enqueue > dequeue ? enqueue - dequeue : 0;
+  }
+
   mtx_lock(&channel->lock);
   uint64_t length = channel->messages.length - channel->head;
   mtx_unlock(&channel->lock);
@@ -144,6 +439,10 @@ uint64_t lovrChannelGetCount(Channel* channel) {
 }
 
 bool lovrChannelHasRead(Channel* channel, uint64_t id) {
+  if (channel->capacity > 0) {
+    return atomic_load64(&channel->popped) >= id;
+  }
+
   mtx_lock(&channel->lock);
   bool received = channel->received >= id;
   mtx_unlock(&channel->lock);
@@ -6,10 +6,14 @@
 struct Variant;
 
 typedef struct Channel Channel;
-Channel* lovrChannelCreate(uint64_t hash);
+Channel* lovrChannelCreate(uint64_t hash, uint32_t capacity);
 void lovrChannelDestroy(void* ref);
+uint32_t lovrChannelGetCapacity(Channel* channel);
 bool lovrChannelPush(Channel* channel, struct Variant* variant, double timeout, uint64_t* id);
+bool lovrChannelPushMany(Channel* channel, struct Variant* variants, uint32_t* count, double timeout, uint64_t* id);
 bool lovrChannelPop(Channel* channel, struct Variant* variant, double timeout);
+uint32_t lovrChannelPopMany(Channel* channel, struct Variant* variants, uint32_t max, double timeout);
+int lovrChannelSelect(Channel** channels, uint32_t count, struct Variant* variant, double timeout);
 bool lovrChannelPeek(Channel* channel, struct Variant* variant);
 void lovrChannelClear(Channel* channel);
 uint64_t lovrChannelGetCount(Channel* channel);
@@ -0,0 +1,318 @@
+#include "thread/job.h"
+#include "core/atomic.h"
+#include "core/arr.h"
+#include "core/ref.h"
+#include "core/util.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct Job {
+  JobFn* fn;
+  void* context;
+  void (*destructor)(void* context);
+  atomic64 done;
+};
+
+// Each worker owns a deque.  The owner pushes and pops at the back, so nested work runs newest
+// first while it's still in cache.  Idle workers steal from the front, taking the oldest work.
+typedef struct {
+  mtx_t lock;
+  arr_t(Job*) jobs;
+  size_t head;
+  char padding[64];
+} Deque;
+
+typedef struct {
+  JobRangeFn* fn;
+  void* context;
+  uint32_t start;
+  uint32_t end;
+} JobRange;
+
+static struct {
+  bool initialized;
+  bool quit;
+  uint32_t workerCount;
+  thrd_t workers[MAX_WORKERS];
+  Deque deques[MAX_WORKERS];
+  JobHook* start;
+  JobHook* stop;
+  mtx_t lock;
+  cnd_t work;
+  cnd_t done;
+  atomic64 queued;
+  atomic64 sleepers;
+  atomic64 waiters;
+  atomic64 next;
+} state;
+
+// Worker index plus one, so zero means the current thread isn't a worker
+static LOVR_THREAD_LOCAL uint32_t currentWorker;
+
+static void pushBack(Deque* deque, Job* job) {
+  mtx_lock(&deque->lock);
+  arr_push(&deque->jobs, job);
+  mtx_unlock(&deque->lock);
+}
+
+static Job* popBack(Deque* deque) {
+  Job* job = NULL;
+  mtx_lock(&deque->lock);
+  if (deque->head < deque->jobs.length) {
+    job = arr_pop(&deque->jobs);
+    if (deque->head == deque->jobs.length) {
+      deque->head = deque->jobs.length = 0;
+    }
+  }
+  mtx_unlock(&deque->lock);
+  return job;
+}
+
+static Job* popFront(Deque* deque) {
+  Job* job = NULL;
+  mtx_lock(&deque->lock);
+  if (deque->head < deque->jobs.length) {
+    job = deque->jobs.data[deque->head++];
+    if (deque->head == deque->jobs.length) {
+      deque->head = deque->jobs.length = 0;
+    }
+  }
+  mtx_unlock(&deque->lock);
+  return job;
+}
+
+static Job* lovrJobTake(uint32_t worker) {
+  if (atomic_load64(&state.queued) == 0) {
+    return NULL;
+  }
+
+  Job* job = popBack(&state.deques[worker]);
+
+  for (uint32_t i = 1; !job && i < state.workerCount; i++) {
+    job = popFront(&state.deques[(worker + i) % state.workerCount]);
+  }
+
+  if (job) {
+    atomic_add64(&state.queued, -1);
+  }
+
+  return job;
+}
+
+static void lovrJobRun(Job* job) {
+  job->fn(job->context);
+  atomic_store64(&job->done, 1);
+
+  if (atomic_load64(&state.waiters) > 0) {
+    mtx_lock(&state.lock);
+    cnd_broadcast(&state.done);
+    mtx_unlock(&state.lock);
+  }
+
+  lovrRelease(Job, job);
+}
+
+static int lovrJobWorker(void* arg) {
+  uint32_t worker = (uint32_t) (uintptr_t) arg;
+  currentWorker = worker + 1;
+
+  if (state.start) {
+    state.start(worker);
+  }
+
+  for (;;) {
+    Job* job = lovrJobTake(worker);
+
+    if (job) {
+      lovrJobRun(job);
+      continue;
+    }
+
+    mtx_lock(&state.lock);
+    atomic_add64(&state.sleepers, 1);
+    while (atomic_load64(&state.queued) == 0 && !state.quit) {
+      cnd_wait(&state.work, &state.lock);
+    }
+    atomic_add64(&state.sleepers, -1);
+    bool quit = state.quit && atomic_load64(&state.queued) == 0;
+    mtx_unlock(&state.lock);
+
+    if (quit) {
+      break;
+    }
+  }
+
+  if (state.stop) {
+    state.stop(worker);
+  }
+
+  return 0;
+}
+
+// The start/stop hooks run on each worker thread, and can be used to set up per-worker state
+bool lovrJobSystemInit(uint32_t workerCount, JobHook* start, JobHook* stop) {
+  if (state.initialized) return false;
+  state.workerCount = MIN(MAX(workerCount, 1), MAX_WORKERS);
+  state.start = start;
+  state.stop = stop;
+  mtx_init(&state.lock, mtx_plain);
+  cnd_init(&state.work);
+  cnd_init(&state.done);
+
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    mtx_init(&state.deques[i].lock, mtx_plain);
+    arr_init(&state.deques[i].jobs);
+  }
+
+  state.initialized = true;
+
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    if (thrd_create(&state.workers[i], lovrJobWorker, (void*) (uintptr_t) i) != thrd_success) {
+      lovrThrow("Could not create worker thread");
+    }
+  }
+
+  return true;
+}
+
+// Jobs that are still queued get finished before the workers exit
+void lovrJobSystemDestroy() {
+  if (!state.initialized) return;
+
+  mtx_lock(&state.lock);
+  state.quit = true;
+  cnd_broadcast(&state.work);
+  mtx_unlock(&state.lock);
+
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    thrd_join(state.workers[i], NULL);
+    mtx_destroy(&state.deques[i].lock);
+    arr_free(&state.deques[i].jobs);
+  }
+
+  mtx_destroy(&state.lock);
+  cnd_destroy(&state.work);
+  cnd_destroy(&state.done);
+  memset(&state, 0, sizeof(state));
+}
+
+uint32_t lovrJobGetWorkerCount() {
+  return state.workerCount;
+}
+
+// Returns ~0u when called from a thread that isn't a worker
+uint32_t lovrJobGetWorkerIndex() {
+  return currentWorker - 1;
+}
+
+// The destructor (if any) is called on the context when the last reference to the Job is released.
+// Jobs submitted from a worker go to its own deque, others are spread across the workers.
+Job* lovrJobSubmit(JobFn* fn, void* context, void (*destructor)(void* context)) {
+  lovrAssert(state.initialized, "The job system is not initialized");
+  Job* job = lovrAlloc(Job);
+  job->fn = fn;
+  job->context = context;
+  job->destructor = destructor;
+  lovrRetain(job);
+
+  uint32_t worker = currentWorker ? currentWorker - 1 : atomic_add64(&state.next, 1) % state.workerCount;
+  atomic_add64(&state.queued, 1);
+  pushBack(&state.deques[worker], job);
+
+  // Idle workers sleep on a different condition variable than threads waiting on jobs, so the signal
+  // can't be used up by a waiter.  Workers that are waiting on a job can run this one instead, so
+  // the waiters get woken too.
+  if (atomic_load64(&state.sleepers) > 0 || atomic_load64(&state.waiters) > 0) {
+    mtx_lock(&state.lock);
+    cnd_signal(&state.work);
+    if (atomic_load64(&state.waiters) > 0) {
+      cnd_broadcast(&state.done);
+    }
+    mtx_unlock(&state.lock);
+  }
+
+  return job;
+}
+
+void lovrJobDestroy(void* ref) {
+  Job* job = ref;
+  if (job->destructor) {
+    job->destructor(job->context);
+  }
+}
+
+void* lovrJobGetContext(Job* job) {
+  return job->context;
+}
+
+bool lovrJobIsDone(Job* job) {
+  return atomic_load64(&job->done);
+}
+
+// Workers run other jobs while they wait, so jobs can wait on jobs they submit without running out
+// of workers.  Other threads just block.
+void lovrJobWait(Job* job) {
+  uint32_t worker = currentWorker;
+
+  while (!lovrJobIsDone(job)) {
+    if (worker) {
+      Job* other = lovrJobTake(worker - 1);
+      if (other) {
+        lovrJobRun(other);
+        continue;
+      }
+    }
+
+    mtx_lock(&state.lock);
+    atomic_add64(&state.waiters, 1);
+    while (!lovrJobIsDone(job) && (!worker || atomic_load64(&state.queued) == 0)) {
+      cnd_wait(&state.done, &state.lock);
+    }
+    atomic_add64(&state.waiters, -1);
+    mtx_unlock(&state.lock);
+  }
+}
+
+static void lovrJobRunRange(void* context) {
+  JobRange* range = context;
+  range->fn(range->context, range->start, range->end);
+}
+
+// Calls fn with consecutive ranges covering [0, count), at least grain items at a time.  The grain
+// is increased if needed to keep the number of jobs to a small multiple of the worker count.  The
+// ranges always run on workers, even if there's only one, so fn can rely on per-worker state.
+void lovrJobParallelFor(uint32_t count, uint32_t grain, JobRangeFn* fn, void* context) {
+  uint32_t maxJobs = state.workerCount * 4;
+  grain = MAX(grain, 1);
+
+  if (count == 0) {
+    return;
+  } else if (!state.initialized) {
+    fn(context, 0, count);
+    return;
+  } else if ((count + grain - 1) / grain > maxJobs) {
+    grain = (count + maxJobs - 1) / maxJobs;
+  }
+
+  uint32_t jobCount = (count + grain - 1) / grain;
+  JobRange* ranges = malloc(jobCount * sizeof(JobRange));
+  Job** jobs = malloc(jobCount * sizeof(Job*));
+  lovrAssert(ranges && jobs, "Out of memory");
+
+  for (uint32_t i = 0; i < jobCount; i++) {
+    ranges[i].fn = fn;
+    ranges[i].context = context;
+    ranges[i].start = i * grain;
+    ranges[i].end = MIN(ranges[i].start + grain, count);
+    jobs[i] = lovrJobSubmit(lovrJobRunRange, &ranges[i], NULL);
+  }
+
+  for (uint32_t i = 0; i < jobCount; i++) {
+    lovrJobWait(jobs[i]);
+    lovrRelease(Job, jobs[i]);
+  }
+
+  free(ranges);
+  free(jobs);
+}
@@ -0,0 +1,23 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define MAX_WORKERS 64
+
+typedef void JobFn(void* context);
+typedef void JobRangeFn(void* context, uint32_t start, uint32_t end);
+typedef void JobHook(uint32_t worker);
+
+typedef struct Job Job;
+
+bool lovrJobSystemInit(uint32_t workerCount, JobHook* start, JobHook* stop);
+void lovrJobSystemDestroy(void);
+uint32_t lovrJobGetWorkerCount(void);
+uint32_t lovrJobGetWorkerIndex(void);
+Job* lovrJobSubmit(JobFn* fn, void* context, void (*destructor)(void* context));
+void lovrJobDestroy(void* ref);
+void* lovrJobGetContext(Job* job);
+bool lovrJobIsDone(Job* job);
+void lovrJobWait(Job* job);
+void lovrJobParallelFor(uint32_t count, uint32_t grain, JobRangeFn* fn, void* context);
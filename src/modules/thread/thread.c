@@ -8,51 +8,210 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Threads can run on a pool of host threads that outlive them, so the per-thread setup done by the
+// start hook (creating a Lua state) is paid once per host instead of once per Thread.  Starting a
+// Thread when every host is busy falls back to creating a thread for it.  Hosts that are still
+// running a Thread at shutdown are left to finish on their own, so the pool is freed by whoever
+// lets go of it last.
+
+typedef struct {
+  thrd_t handle;
+  Thread* thread;
+} ThreadHost;
+
+typedef struct {
+  mtx_t lock;
+  cnd_t cond;
+  arr_t(Thread*) queue;
+  size_t head;
+  ThreadHost* hosts;
+  uint32_t hostCount;
+  uint32_t refs;
+  bool quit;
+  ThreadHook* start;
+  ThreadHook* stop;
+} ThreadPool;
+
+typedef struct {
+  ThreadPool* pool;
+  uint32_t index;
+} ThreadHostInfo;
+
 static struct {
   bool initialized;
+  mtx_t channelLock;
   arr_t(Channel*) channels;
   map_t channelMap;
+  ThreadPool* pool;
 } state;
 
-bool lovrThreadModuleInit() {
+static bool releasePool(ThreadPool* pool) {
+  mtx_lock(&pool->lock);
+  bool last = --pool->refs == 0;
+  mtx_unlock(&pool->lock);
+
+  if (last) {
+    mtx_destroy(&pool->lock);
+    cnd_destroy(&pool->cond);
+    arr_free(&pool->queue);
+    free(pool->hosts);
+    free(pool);
+  }
+
+  return last;
+}
+
+static int hostLoop(void* arg) {
+  ThreadHostInfo info = *(ThreadHostInfo*) arg;
+  ThreadPool* pool = info.pool;
+  free(arg);
+
+  if (pool->start) {
+    pool->start();
+  }
+
+  mtx_lock(&pool->lock);
+  for (;;) {
+    while (pool->head == pool->queue.length && !pool->quit) {
+      cnd_wait(&pool->cond, &pool->lock);
+    }
+
+    if (pool->head == pool->queue.length) {
+      break;
+    }
+
+    Thread* thread = pool->queue.data[pool->head++];
+    if (pool->head == pool->queue.length) {
+      pool->head = pool->queue.length = 0;
+    }
+    pool->hosts[info.index].thread = thread;
+    mtx_unlock(&pool->lock);
+
+    thread->runner(thread);
+
+    mtx_lock(&thread->lock);
+    cnd_broadcast(&thread->finished);
+    mtx_unlock(&thread->lock);
+
+    mtx_lock(&pool->lock);
+    pool->hosts[info.index].thread = NULL;
+    mtx_unlock(&pool->lock);
+    lovrRelease(Thread, thread);
+    mtx_lock(&pool->lock);
+  }
+  mtx_unlock(&pool->lock);
+
+  if (pool->stop) {
+    pool->stop();
+  }
+
+  releasePool(pool);
+  return 0;
+}
+
+static ThreadPool* createPool(uint32_t size, ThreadHook* start, ThreadHook* stop) {
+  ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+  lovrAssert(pool, "Out of memory");
+  pool->hosts = calloc(size, sizeof(ThreadHost));
+  lovrAssert(pool->hosts, "Out of memory");
+  mtx_init(&pool->lock, mtx_plain);
+  cnd_init(&pool->cond);
+  arr_init(&pool->queue);
+  pool->start = start;
+  pool->stop = stop;
+  pool->refs = 1;
+
+  for (uint32_t i = 0; i < size; i++) {
+    ThreadHostInfo* info = malloc(sizeof(ThreadHostInfo));
+    lovrAssert(info, "Out of memory");
+    info->pool = pool;
+    info->index = i;
+    pool->refs++;
+    if (thrd_create(&pool->hosts[i].handle, hostLoop, info) != thrd_success) {
+      free(info);
+      pool->refs--;
+      break;
+    }
+    pool->hostCount++;
+  }
+
+  return pool;
+}
+
+// Idle hosts are joined, busy ones are detached and exit when their Thread returns
+static void destroyPool(ThreadPool* pool) {
+  mtx_lock(&pool->lock);
+  pool->quit = true;
+  cnd_broadcast(&pool->cond);
+  uint32_t count = pool->hostCount;
+  bool* busy = malloc(count * sizeof(bool));
+  lovrAssert(busy || count == 0, "Out of memory");
+  for (uint32_t i = 0; i < count; i++) {
+    busy[i] = pool->hosts[i].thread || pool->head < pool->queue.length;
+  }
+  mtx_unlock(&pool->lock);
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (busy[i]) {
+      thrd_detach(pool->hosts[i].handle);
+    } else {
+      thrd_join(pool->hosts[i].handle, NULL);
+    }
+  }
+
+  free(busy);
+  releasePool(pool);
+}
+
+// The start and stop hooks run on each host thread of the pool
+bool lovrThreadModuleInit(uint32_t poolSize, ThreadHook* start, ThreadHook* stop) {
   if (state.initialized) return false;
+  mtx_init(&state.channelLock, mtx_plain);
   arr_init(&state.channels);
   map_init(&state.channelMap, 0);
+  state.pool = poolSize > 0 ? createPool(poolSize, start, stop) : NULL;
   return state.initialized = true;
 }
 
 void lovrThreadModuleDestroy() {
   if (!state.initialized) return;
+  if (state.pool) {
+    destroyPool(state.pool);
+    state.pool = NULL;
+  }
   for (size_t i = 0; i < state.channels.length; i++) {
     lovrRelease(Channel, state.channels.data[i]);
   }
   arr_free(&state.channels);
   map_free(&state.channelMap);
+  mtx_destroy(&state.channelLock);
   state.initialized = false;
 }
 
-Channel* lovrThreadGetChannel(const char* name) {
+// A capacity of zero gets the existing Channel, or creates an unbounded one.  Channels are looked up
+// from every thread, and stay alive until the module is destroyed, so the Channel returned is a
+// new reference the caller has to release.
+Channel* lovrThreadGetChannel(const char* name, uint32_t capacity) {
   uint64_t hash = hash64(name, strlen(name));
+  mtx_lock(&state.channelLock);
   uint64_t index = map_get(&state.channelMap, hash);
 
   if (index == MAP_NIL) {
     index = state.channels.length;
     map_set(&state.channelMap, hash, index);
-    arr_push(&state.channels, lovrChannelCreate(hash));
+    arr_push(&state.channels, lovrChannelCreate(hash, capacity));
   }
 
-  return state.channels.data[index];
-}
-
-void lovrThreadRemoveChannel(uint64_t hash) {
-  uint64_t index = map_get(&state.channelMap, hash);
+  Channel* channel = state.channels.data[index];
+  lovrRetain(channel);
+  mtx_unlock(&state.channelLock);
 
-  if (index == MAP_NIL) {
-    return;
+  if (capacity != 0 && lovrChannelGetCapacity(channel) != capacity) {
+    lovrRelease(Channel, channel);
+    lovrThrow("Channel '%s' already exists with a different capacity", name);
   }
 
-  map_remove(&state.channelMap, hash);
-  arr_splice(&state.channels, index, 1);
+  return channel;
 }
 
 Thread* lovrThreadInit(Thread* thread, int (*runner)(void*), Blob* body) {
@@ -60,13 +219,17 @@ Thread* lovrThreadInit(Thread* thread, int (*runner)(void*), Blob* body) {
   thread->runner = runner;
   thread->body = body;
   mtx_init(&thread->lock, mtx_plain);
+  cnd_init(&thread->finished);
   return thread;
 }
 
 void lovrThreadDestroy(void* ref) {
   Thread* thread = ref;
   mtx_destroy(&thread->lock);
-  thrd_detach(thread->handle);
+  cnd_destroy(&thread->finished);
+  if (!thread->pooled) {
+    thrd_detach(thread->handle);
+  }
   lovrRelease(Blob, thread->body);
   free(thread->error);
 }
@@ -83,13 +246,54 @@ void lovrThreadStart(Thread* thread, Variant* arguments, size_t argumentCount) {
   lovrAssert(argumentCount <= MAX_THREAD_ARGUMENTS, "Too many Thread arguments (max is %d)\n", MAX_THREAD_ARGUMENTS);
   thread->argumentCount = argumentCount;
   memcpy(thread->arguments, arguments, argumentCount * sizeof(Variant));
+
+  // The Thread counts as running as soon as it's started, so waiting on it can't miss it
+  mtx_lock(&thread->lock);
+  thread->running = true;
+  mtx_unlock(&thread->lock);
+
+  ThreadPool* pool = state.pool;
+  if (pool) {
+    // A host counts as free as soon as its Thread stops running, even if it hasn't gone back to
+    // waiting yet, otherwise starting a Thread right after waiting on one would miss the pool
+    mtx_lock(&pool->lock);
+    uint32_t available = 0;
+    for (uint32_t i = 0; i < pool->hostCount; i++) {
+      Thread* other = pool->hosts[i].thread;
+      available += !other || other == thread || !lovrThreadIsRunning(other);
+    }
+    thread->pooled = !pool->quit && available > pool->queue.length - pool->head;
+    if (thread->pooled) {
+      lovrRetain(thread);
+      arr_push(&pool->queue, thread);
+      cnd_signal(&pool->cond);
+    }
+    mtx_unlock(&pool->lock);
+
+    if (thread->pooled) {
+      return;
+    }
+  }
+
   if (thrd_create(&thread->handle, thread->runner, thread) != thrd_success) {
+    mtx_lock(&thread->lock);
+    thread->running = false;
+    mtx_unlock(&thread->lock);
     lovrThrow("Could not create thread...sorry");
   }
 }
 
 void lovrThreadWait(Thread* thread) {
-  thrd_join(thread->handle, NULL);
+  if (!thread->pooled) {
+    thrd_join(thread->handle, NULL);
+    return;
+  }
+
+  mtx_lock(&thread->lock);
+  while (thread->running) {
+    cnd_wait(&thread->finished, &thread->lock);
+  }
+  mtx_unlock(&thread->lock);
 }
 
 bool lovrThreadIsRunning(Thread* thread) {
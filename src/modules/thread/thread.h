@@ -8,6 +8,8 @@
 
 #define MAX_THREAD_ARGUMENTS 4
 
+typedef void ThreadHook(void);
+
 struct Channel;
 
 typedef struct Thread {
@@ -19,12 +21,13 @@ typedef struct Thread {
   int (*runner)(void*);
   char* error;
   bool running;
+  bool pooled;
+  cnd_t finished;
 } Thread;
 
-bool lovrThreadModuleInit(void);
+bool lovrThreadModuleInit(uint32_t poolSize, ThreadHook* start, ThreadHook* stop);
 void lovrThreadModuleDestroy(void);
-struct Channel* lovrThreadGetChannel(const char* name);
-void lovrThreadRemoveChannel(uint64_t hash);
+struct Channel* lovrThreadGetChannel(const char* name, uint32_t capacity);
 
 Thread* lovrThreadInit(Thread* thread, int (*runner)(void*), Blob* body);
 #define lovrThreadCreate(...) lovrThreadInit(lovrAlloc(Thread), __VA_ARGS__)
@@ -95,6 +95,17 @@ function lovr.boot()
       thread = true,
       timer = true
     },
+    event = {
+      capacity = 256,
+      fixed = false
+    },
+    graphics = {
+      streams = {
+        vertices = 65536,
+        indices = 65536
+      },
+      uploadbudget = .002
+    },
     headset = {
       drivers = { 'leap', 'openxr', 'oculus', 'oculusmobile', 'openvr', 'webvr', 'desktop' },
       offset = 1.7,
@@ -103,6 +114,10 @@ function lovr.boot()
     math = {
       globals = true
     },
+    thread = {
+      workers = -1,
+      pool = 2
+    },
     window = {
       width = 1080,
       height = 600,
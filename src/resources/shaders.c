@@ -2,7 +2,7 @@
 
 const char* lovrShaderVertexPrefix = ""
 "#define VERTEX VERTEX \n"
-"#define MAX_BONES 48 \n"
+"#define MAX_BONES 256 \n"
 "#define MAX_DRAWS 256 \n"
 "#define lovrView lovrViews[lovrViewID] \n"
 "#define lovrProjection lovrProjections[lovrViewID] \n"
@@ -42,7 +42,11 @@ const char* lovrShaderVertexPrefix = ""
 "layout(std140) uniform lovrFrameBlock { mat4 lovrViews[2]; mat4 lovrProjections[2]; }; \n"
 "uniform mat3 lovrMaterialTransform; \n"
 "uniform float lovrPointSize; \n"
-"uniform mat4 lovrPose[MAX_BONES]; \n"
+"#if __VERSION__ >= 430 \n"
+"layout(std430) readonly buffer lovrPoseBlock { mat4 lovrPose[]; }; \n"
+"#else \n"
+"layout(std140) uniform lovrPoseBlock { mat4 lovrPose[MAX_BONES]; }; \n"
+"#endif \n"
 "uniform lowp int lovrViewportCount; \n"
 "#if defined MULTIVIEW \n"
 "layout(num_views = 2) in; \n"
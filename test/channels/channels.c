@@ -0,0 +1,429 @@
+// Stress tests Channels and lovrChannelSelect from several threads, then measures them.
+//
+// Producers and consumers hammer unbounded Channels and bounded ones of a few sizes with single and
+// batched pushes and pops, and every message has to arrive exactly once, in order for each producer.
+// Select is checked for fairness (a full Channel first in the list can't starve the others), for
+// timeouts, for waking up when a message arrives, and with several selectors at once.  If anything
+// stops making progress, the test fails instead of hanging.  The benchmark compares throughput of
+// unbounded and bounded Channels, and the round trip time of select against polling.
+
+#include "thread/channel.h"
+#include "event/event.h"
+#include "core/atomic.h"
+#include "core/ref.h"
+#include "core/util.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define MESSAGES 50000
+#define TOTAL (PRODUCERS * MESSAGES)
+#define BATCH 16
+#define CHANNELS 4
+
+void lovrThrow(const char* format, ...) {
+  puts(format);
+  abort();
+}
+
+// Only numbers are sent, so there's nothing to free, and the event module isn't needed
+void lovrVariantDestroy(Variant* variant) {
+  //
+}
+
+static double getTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static Variant number(double x) {
+  Variant variant;
+  variant.type = TYPE_NUMBER;
+  variant.value.number = x;
+  return variant;
+}
+
+static Channel* channels[CHANNELS];
+static atomic64 seen[TOTAL];
+static atomic64 progress;
+static atomic64 finished;
+static uint32_t producerChannels;
+
+// Fails if progress stops moving for a second before it reaches the target
+static void watch(uint64_t target, const char* what) {
+  uint64_t last = 0;
+  double lastProgress = getTime();
+  while (atomic_load64(&progress) < target) {
+    usleep(1000);
+    uint64_t now = atomic_load64(&progress);
+    if (now != last) {
+      last = now;
+      lastProgress = getTime();
+    } else if (getTime() - lastProgress > 1.) {
+      printf("FAIL: %s got stuck after %llu of %llu messages\n", what, (unsigned long long) now, (unsigned long long) target);
+      exit(1);
+    }
+  }
+}
+
+// Pushes its messages to a Channel (or spreads them over all of them), alternating between single
+// pushes and batches of different sizes
+static int producer(void* arg) {
+  uint32_t p = (uint32_t) (uintptr_t) arg;
+  Variant batch[BATCH];
+  uint32_t i = 0;
+  uint64_t id;
+
+  while (i < MESSAGES) {
+    Channel* channel = channels[(p + i) % producerChannels];
+    double timeout = lovrChannelGetCapacity(channel) > 0 ? INFINITY : NAN;
+    uint32_t count = MIN(i % BATCH + 1, MESSAGES - i);
+
+    for (uint32_t j = 0; j < count; j++) {
+      batch[j] = number(p * MESSAGES + i + j);
+    }
+
+    if (count == 1) {
+      lovrChannelPush(channel, &batch[0], timeout, &id);
+    } else {
+      uint32_t pushed = count;
+      lovrChannelPushMany(channel, batch, &pushed, timeout, &id);
+      CHECK(pushed == count);
+    }
+
+    i += count;
+  }
+
+  return 0;
+}
+
+static void receive(Variant* variant, uint32_t* last) {
+  CHECK(variant->type == TYPE_NUMBER);
+  uint32_t message = (uint32_t) variant->value.number;
+  CHECK(message < TOTAL);
+  CHECK(atomic_add64(&seen[message], 1) == 1);
+
+  // Messages from one producer on one Channel stay in order
+  uint32_t p = message / MESSAGES;
+  if (producerChannels == 1) {
+    CHECK(last[p] == ~0u || message > last[p]);
+    last[p] = message;
+  }
+
+  atomic_add64(&progress, 1);
+}
+
+// Pops until it gets a negative number, in batches of different sizes
+static int consumer(void* arg) {
+  Channel* channel = channels[0];
+  Variant variants[BATCH];
+  uint32_t last[PRODUCERS];
+  memset(last, 0xff, sizeof(last));
+
+  for (uint32_t round = 0;; round++) {
+    uint32_t count = lovrChannelPopMany(channel, variants, round % BATCH + 1, INFINITY);
+    CHECK(count > 0 && count <= round % BATCH + 1);
+    for (uint32_t i = 0; i < count; i++) {
+      if (variants[i].value.number < 0) {
+        CHECK(i == count - 1);
+        atomic_add64(&finished, 1);
+        return 0;
+      }
+      receive(&variants[i], last);
+    }
+  }
+}
+
+static int selector(void* arg) {
+  Variant variant;
+  uint32_t last[PRODUCERS];
+  memset(last, 0xff, sizeof(last));
+
+  for (;;) {
+    int index = lovrChannelSelect(channels, CHANNELS, &variant, INFINITY);
+    CHECK(index >= 0 && index < CHANNELS);
+    if (variant.value.number < 0) {
+      atomic_add64(&finished, 1);
+      return 0;
+    }
+    receive(&variant, last);
+  }
+}
+
+static void reset(void) {
+  memset(seen, 0, sizeof(seen));
+  atomic_store64(&progress, 0);
+  atomic_store64(&finished, 0);
+}
+
+// Sends one negative number per consumer, waiting for each one to exit so none of them can take two
+static void stop(uint32_t consumers) {
+  uint64_t id;
+  Variant message = number(-1);
+  for (uint32_t i = 0; i < consumers; i++) {
+    lovrChannelPush(channels[i % producerChannels], &message, INFINITY, &id);
+    while (atomic_load64(&finished) <= i) {
+      usleep(100);
+    }
+  }
+}
+
+static void checkSeen(void) {
+  for (uint32_t i = 0; i < TOTAL; i++) {
+    CHECK(atomic_load64(&seen[i]) == 1);
+  }
+}
+
+static void exactlyOnce(uint32_t capacity) {
+  channels[0] = lovrChannelCreate(0, capacity);
+  producerChannels = 1;
+  reset();
+
+  thrd_t producers[PRODUCERS];
+  thrd_t consumers[CONSUMERS];
+  for (uint32_t i = 0; i < CONSUMERS; i++) {
+    CHECK(thrd_create(&consumers[i], consumer, NULL) == thrd_success);
+  }
+  for (uint32_t i = 0; i < PRODUCERS; i++) {
+    CHECK(thrd_create(&producers[i], producer, (void*) (uintptr_t) i) == thrd_success);
+  }
+
+  watch(TOTAL, capacity > 0 ? "a bounded Channel" : "an unbounded Channel");
+
+  stop(CONSUMERS);
+
+  for (uint32_t i = 0; i < PRODUCERS; i++) {
+    thrd_join(producers[i], NULL);
+  }
+  for (uint32_t i = 0; i < CONSUMERS; i++) {
+    thrd_join(consumers[i], NULL);
+  }
+
+  checkSeen();
+  CHECK(lovrChannelGetCount(channels[0]) == 0);
+  lovrRelease(Channel, channels[0]);
+  printf("ok %d messages through a Channel with capacity %u\n", TOTAL, capacity);
+}
+
+// A mix of bounded and unbounded Channels, with producers spreading messages over all of them and
+// several threads selecting at once
+static void selectMany(void) {
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    channels[i] = lovrChannelCreate(i, i % 2 ? 0 : 1 << (2 * i));
+  }
+  producerChannels = CHANNELS;
+  reset();
+
+  thrd_t producers[PRODUCERS];
+  thrd_t selectors[CONSUMERS];
+  for (uint32_t i = 0; i < CONSUMERS; i++) {
+    CHECK(thrd_create(&selectors[i], selector, NULL) == thrd_success);
+  }
+  for (uint32_t i = 0; i < PRODUCERS; i++) {
+    CHECK(thrd_create(&producers[i], producer, (void*) (uintptr_t) i) == thrd_success);
+  }
+
+  watch(TOTAL, "select");
+
+  stop(CONSUMERS);
+
+  for (uint32_t i = 0; i < PRODUCERS; i++) {
+    thrd_join(producers[i], NULL);
+  }
+  for (uint32_t i = 0; i < CONSUMERS; i++) {
+    thrd_join(selectors[i], NULL);
+  }
+
+  checkSeen();
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    CHECK(lovrChannelGetCount(channels[i]) == 0);
+    lovrRelease(Channel, channels[i]);
+  }
+  printf("ok %d messages through select on %d Channels\n", TOTAL, CHANNELS);
+}
+
+// Every Channel is full, so a select that always looked at the first one first would never get to
+// the others
+static void selectFairness(void) {
+  enum { QUEUED = 64 };
+  uint32_t counts[CHANNELS] = { 0 };
+  Variant variant;
+  uint64_t id;
+
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    channels[i] = lovrChannelCreate(i, i % 2 ? 0 : QUEUED);
+    for (uint32_t j = 0; j < QUEUED; j++) {
+      Variant message = number(i);
+      CHECK(lovrChannelPush(channels[i], &message, NAN, &id) || i % 2);
+    }
+  }
+
+  for (uint32_t i = 0; i < QUEUED; i++) {
+    int index = lovrChannelSelect(channels, CHANNELS, &variant, 0.);
+    CHECK(index >= 0 && variant.value.number == index);
+    counts[index]++;
+  }
+
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    CHECK(counts[i] >= QUEUED / CHANNELS / 2);
+    lovrRelease(Channel, channels[i]);
+  }
+  printf("ok select picked %u %u %u %u times from %d full Channels\n", counts[0], counts[1], counts[2], counts[3], CHANNELS);
+}
+
+static int pushLater(void* arg) {
+  uint64_t id;
+  Variant message = number(42);
+  usleep(20000);
+  lovrChannelPush(arg, &message, NAN, &id);
+  return 0;
+}
+
+static void selectTimeouts(void) {
+  Variant variant;
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    channels[i] = lovrChannelCreate(i, i % 2 ? 0 : 8);
+  }
+
+  // NaN and negative timeouts don't wait at all
+  double start = getTime();
+  CHECK(lovrChannelSelect(channels, CHANNELS, &variant, NAN) == -1);
+  CHECK(lovrChannelSelect(channels, CHANNELS, &variant, -1.) == -1);
+  CHECK(lovrChannelSelect(channels, 0, &variant, 0.) == -1);
+  CHECK(getTime() - start < .01);
+
+  // A timeout waits about that long, and returns nothing
+  for (int i = 0; i < 3; i++) {
+    double timeout = .01 + .02 * i;
+    start = getTime();
+    CHECK(lovrChannelSelect(channels, CHANNELS, &variant, timeout) == -1);
+    double elapsed = getTime() - start;
+    CHECK(elapsed >= timeout * .9 && elapsed < timeout + .25);
+  }
+
+  // A message that arrives while waiting wakes it up, on a bounded and an unbounded Channel
+  for (uint32_t i = 2; i < CHANNELS; i++) {
+    thrd_t thread;
+    CHECK(thrd_create(&thread, pushLater, channels[i]) == thrd_success);
+    start = getTime();
+    CHECK(lovrChannelSelect(channels, CHANNELS, &variant, 5.) == (int) i);
+    CHECK(variant.value.number == 42 && getTime() - start < 1.);
+    thrd_join(thread, NULL);
+  }
+
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    lovrRelease(Channel, channels[i]);
+  }
+  printf("ok select timeouts\n");
+}
+
+static int drain(void* arg) {
+  Variant variants[BATCH];
+  for (uint32_t received = 0; received < TOTAL;) {
+    received += lovrChannelPopMany(arg, variants, BATCH, INFINITY);
+  }
+  return 0;
+}
+
+static void benchThroughput(uint32_t capacity) {
+  Channel* channel = lovrChannelCreate(0, capacity);
+  double timeout = capacity > 0 ? INFINITY : NAN;
+  thrd_t thread;
+  uint64_t id;
+
+  double start = getTime();
+  CHECK(thrd_create(&thread, drain, channel) == thrd_success);
+  for (uint32_t i = 0; i < TOTAL; i++) {
+    Variant message = number(i);
+    lovrChannelPush(channel, &message, timeout, &id);
+  }
+  thrd_join(thread, NULL);
+  double time = getTime() - start;
+
+  lovrRelease(Channel, channel);
+  printf("capacity %5u: %6.2f M messages/s\n", capacity, TOTAL / time / 1e6);
+}
+
+// Answers pings on any of the Channels with a pong on the last one, either with select or by
+// polling each Channel in turn
+static int answer(void* arg) {
+  bool poll = arg != NULL;
+  Variant variant;
+  uint64_t id;
+
+  for (;;) {
+    int index = -1;
+    if (poll) {
+      while (index < 0) {
+        for (int i = 0; i < CHANNELS - 1 && index < 0; i++) {
+          index = lovrChannelPop(channels[i], &variant, 0.) ? i : -1;
+        }
+        if (index < 0) thrd_yield();
+      }
+    } else {
+      index = lovrChannelSelect(channels, CHANNELS - 1, &variant, INFINITY);
+    }
+
+    lovrChannelPush(channels[CHANNELS - 1], &variant, NAN, &id);
+    if (variant.value.number < 0) {
+      return 0;
+    }
+  }
+}
+
+static void benchRoundTrip(bool poll) {
+  enum { ROUNDS = 20000 };
+  Variant variant;
+  thrd_t thread;
+  uint64_t id;
+
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    channels[i] = lovrChannelCreate(i, 0);
+  }
+
+  CHECK(thrd_create(&thread, answer, poll ? channels : NULL) == thrd_success);
+
+  double start = getTime();
+  for (uint32_t i = 0; i < ROUNDS; i++) {
+    Variant message = number(i);
+    lovrChannelPush(channels[i % (CHANNELS - 1)], &message, NAN, &id);
+    CHECK(lovrChannelPop(channels[CHANNELS - 1], &variant, INFINITY) && variant.value.number == i);
+  }
+  double time = getTime() - start;
+
+  Variant stop = number(-1);
+  lovrChannelPush(channels[0], &stop, NAN, &id);
+  CHECK(lovrChannelPop(channels[CHANNELS - 1], &variant, INFINITY));
+  thrd_join(thread, NULL);
+
+  for (uint32_t i = 0; i < CHANNELS; i++) {
+    lovrRelease(Channel, channels[i]);
+  }
+  printf("%s: %6.2f us per round trip\n", poll ? "polling" : " select", time / ROUNDS * 1e6);
+}
+
+int main(void) {
+  exactlyOnce(0);
+  exactlyOnce(1);
+  exactlyOnce(7);
+  exactlyOnce(1024);
+  selectFairness();
+  selectTimeouts();
+  selectMany();
+
+  benchThroughput(0);
+  benchThroughput(16);
+  benchThroughput(1024);
+  benchRoundTrip(false);
+  benchRoundTrip(true);
+  return 0;
+}
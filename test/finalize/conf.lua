@@ -0,0 +1,9 @@
+function lovr.conf(t)
+  t.identity = 'lovr-test-finalize'
+  t.modules.headset = false
+  t.modules.audio = false
+  t.modules.physics = false
+
+  -- With no time to spare, lovr.graphics.present should finalize exactly one finished job per frame
+  t.graphics.uploadbudget = 0
+end
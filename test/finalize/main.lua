@@ -0,0 +1,116 @@
+-- Checks that async loads are finalized a few at a time instead of all in one frame.  Every load
+-- finishes on the workers before it's finalized, so they're all waiting at the front of the queue,
+-- and with a budget of zero each frame should finalize exactly one of them.
+--
+-- Finalizing happens in lovr.graphics.present, so that's what gets timed.  Frames spent finalizing
+-- should stay close to idle frames: each one can be over by the cost of one upload, but never by
+-- anything near the cost of uploading everything at once.
+
+local count = 16
+local idleFrames = 10
+local jobs = {}
+local ready = 0
+local frames = 0
+local idle = 0
+local worst = 0
+local decode
+local uploadAll
+local deadline
+
+local function fail(message)
+  print('FAIL: ' .. message)
+  lovr.event.quit(1)
+end
+
+local function countReady()
+  local n = 0
+  for i = 1, #jobs do
+    if jobs[i]:isReady() then n = n + 1 end
+  end
+  return n
+end
+
+function lovr.load()
+  -- A grid of triangles, big enough that creating the Model takes a measurable amount of time
+  local lines = {}
+  local size = 100
+  for y = 0, size do
+    for x = 0, size do
+      lines[#lines + 1] = ('v %d %d 0'):format(x, y)
+    end
+  end
+  for y = 0, size - 1 do
+    for x = 0, size - 1 do
+      local a = y * (size + 1) + x + 1
+      lines[#lines + 1] = ('f %d %d %d'):format(a, a + 1, a + size + 2)
+      lines[#lines + 1] = ('f %d %d %d'):format(a, a + size + 2, a + size + 1)
+    end
+  end
+  lovr.filesystem.write('grid.obj', table.concat(lines, '\n') .. '\n')
+
+  local start = lovr.timer.getTime()
+  local modelData = lovr.data.newModelData('grid.obj')
+  decode = lovr.timer.getTime() - start
+
+  -- What finalizing every load in a single frame would cost
+  start = lovr.timer.getTime()
+  for i = 1, count do
+    lovr.graphics.newModel(modelData)
+  end
+  uploadAll = lovr.timer.getTime() - start
+
+  local present = lovr.graphics.present
+  lovr.graphics.present = function()
+    local before = countReady()
+    local start = lovr.timer.getTime()
+    present()
+    local time = lovr.timer.getTime() - start
+    local finalized = countReady() - before
+
+    frames = frames + 1
+    if frames <= idleFrames then
+      idle = math.max(idle, time)
+    elseif finalized > 0 then
+      worst = math.max(worst, time)
+    end
+
+    if finalized > 1 then
+      return fail(('%d loads were finalized in one frame'):format(finalized))
+    end
+  end
+end
+
+function lovr.update(dt)
+  if frames == idleFrames and #jobs == 0 then
+    for i = 1, count do
+      jobs[i] = lovr.graphics.newModelAsync('grid.obj')
+    end
+
+    -- Give every load time to finish on the workers (even if there's only one), so they're all
+    -- ready to finalize at once
+    lovr.timer.sleep(decode * count + .5)
+    deadline = lovr.timer.getTime() + 10
+    return
+  end
+
+  if #jobs == 0 then return end
+
+  ready = countReady()
+  if ready == count then
+    for i = 1, count do
+      local model = jobs[i]:await()
+      if tostring(model) ~= 'Model' then
+        return fail(('job %d returned %s instead of a Model'):format(i, tostring(model)))
+      end
+    end
+
+    if worst > idle + uploadAll / 2 then
+      return fail(('a frame spent %.2fms finalizing, idle frames take %.2fms and uploading everything takes %.2fms'):format(worst * 1000, idle * 1000, uploadAll * 1000))
+    end
+
+    print(('ok: %d loads finalized over %d frames, worst frame %.2fms (idle %.2fms, all at once %.2fms)'):format(count, frames - idleFrames, worst * 1000, idle * 1000, uploadAll * 1000))
+    lovr.event.quit(0)
+  elseif lovr.timer.getTime() > deadline then
+    fail(('only %d of %d loads were finalized after %d frames'):format(ready, count, frames - idleFrames))
+  end
+end
@@ -0,0 +1,163 @@
+// Stress tests the job system, then measures how job throughput scales with the number of workers.
+//
+// The stress test has several threads that aren't workers submitting jobs and waiting on them at
+// the same time as the workers go idle, which is where wakeups can get lost.  If a wait hangs, the
+// test fails instead of hanging.  The benchmark runs lots of small jobs and a parallel for loop with
+// 1, 2, 4... workers, up to the number of cores or the argument.
+
+#include "thread/job.h"
+#include "core/atomic.h"
+#include "core/ref.h"
+#include "core/util.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+#define SUBMITTERS 4
+#define ROUNDS 20000
+
+void lovrThrow(const char* format, ...) {
+  puts(format);
+  abort();
+}
+
+static double getTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static LOVR_THREAD_LOCAL volatile uint32_t sink;
+
+// About a microsecond of work
+static void work(void* context) {
+  uint32_t x = (uint32_t) (uintptr_t) context;
+  for (int i = 0; i < 200; i++) {
+    x = x * 1664525 + 1013904223;
+  }
+  sink = x;
+}
+
+static void workRange(void* context, uint32_t start, uint32_t end) {
+  for (uint32_t i = start; i < end; i++) {
+    work((void*) (uintptr_t) i);
+  }
+}
+
+static atomic64 progress;
+
+static int submitter(void* arg) {
+  for (uint32_t i = 0; i < ROUNDS; i++) {
+    Job* job = lovrJobSubmit(work, (void*) (uintptr_t) i, NULL);
+    lovrJobWait(job);
+    CHECK(lovrJobIsDone(job));
+    lovrRelease(Job, job);
+    atomic_add64(&progress, 1);
+  }
+  return 0;
+}
+
+// Jobs that wait on jobs they submit, so workers have to help while they wait
+static void nested(void* context) {
+  Job* jobs[4];
+  for (int i = 0; i < 4; i++) {
+    jobs[i] = lovrJobSubmit(work, context, NULL);
+  }
+  for (int i = 0; i < 4; i++) {
+    lovrJobWait(jobs[i]);
+    lovrRelease(Job, jobs[i]);
+  }
+}
+
+static void stress(uint32_t workers) {
+  CHECK(lovrJobSystemInit(workers, NULL, NULL));
+  atomic_store64(&progress, 0);
+
+  thrd_t threads[SUBMITTERS];
+  for (int i = 0; i < SUBMITTERS; i++) {
+    CHECK(thrd_create(&threads[i], submitter, NULL) == thrd_success);
+  }
+
+  // Every round should take microseconds, so a second without progress means a wait got stuck
+  uint64_t last = 0;
+  double lastProgress = getTime();
+  while (atomic_load64(&progress) < SUBMITTERS * ROUNDS) {
+    usleep(1000);
+    uint64_t now = atomic_load64(&progress);
+    if (now != last) {
+      last = now;
+      lastProgress = getTime();
+    } else if (getTime() - lastProgress > 1.) {
+      printf("FAIL: stuck after %llu of %d waits with %u workers\n", (unsigned long long) now, SUBMITTERS * ROUNDS, workers);
+      exit(1);
+    }
+  }
+
+  for (int i = 0; i < SUBMITTERS; i++) {
+    thrd_join(threads[i], NULL);
+  }
+
+  Job* jobs[256];
+  for (int i = 0; i < 256; i++) {
+    jobs[i] = lovrJobSubmit(nested, (void*) (uintptr_t) i, NULL);
+  }
+  for (int i = 0; i < 256; i++) {
+    lovrJobWait(jobs[i]);
+    lovrRelease(Job, jobs[i]);
+  }
+
+  lovrJobSystemDestroy();
+  printf("ok stress with %u workers\n", workers);
+}
+
+static void bench(uint32_t workers, double* baseline) {
+  enum { COUNT = 200000 };
+  static Job* jobs[COUNT];
+  CHECK(lovrJobSystemInit(workers, NULL, NULL));
+
+  double start = getTime();
+  for (uint32_t i = 0; i < COUNT; i++) {
+    jobs[i] = lovrJobSubmit(work, (void*) (uintptr_t) i, NULL);
+  }
+  for (uint32_t i = 0; i < COUNT; i++) {
+    lovrJobWait(jobs[i]);
+    lovrRelease(Job, jobs[i]);
+  }
+  double submitTime = getTime() - start;
+
+  start = getTime();
+  lovrJobParallelFor(COUNT * 4, 64, workRange, NULL);
+  double parallelTime = getTime() - start;
+
+  lovrJobSystemDestroy();
+
+  if (workers == 1) {
+    baseline[0] = submitTime;
+    baseline[1] = parallelTime;
+  }
+
+  printf("%3u workers: %6.2f M jobs/s (%4.2fx)  parallel for %6.2f M items/s (%4.2fx)\n", workers,
+    COUNT / submitTime / 1e6, baseline[0] / submitTime,
+    COUNT * 4 / parallelTime / 1e6, baseline[1] / parallelTime);
+}
+
+int main(int argc, char** argv) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t maxWorkers = argc > 1 ? (uint32_t) atoi(argv[1]) : (uint32_t) (cores > 0 ? cores : 1);
+  maxWorkers = maxWorkers > MAX_WORKERS ? MAX_WORKERS : maxWorkers;
+
+  stress(1);
+  stress(2);
+  stress(maxWorkers);
+
+  double baseline[2];
+  for (uint32_t workers = 1; workers < maxWorkers; workers *= 2) {
+    bench(workers, baseline);
+  }
+  bench(maxWorkers, baseline);
+  return 0;
+}
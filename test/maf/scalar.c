@@ -0,0 +1,26 @@
+// The scalar versions of the matrix kernels, for simd.c to check the SIMD ones against
+
+#ifndef MAF_NO_SIMD
+#define MAF_NO_SIMD
+#endif
+#include "core/maf.h"
+
+void scalarMultiply(float* m, float* n) {
+  mat4_multiply(m, n);
+}
+
+void scalarMultiplyVec4(float* m, float* v) {
+  mat4_multiplyVec4(m, v);
+}
+
+void scalarInvert(float* m) {
+  mat4_invert(m);
+}
+
+void scalarTransform(float* m, float* v) {
+  mat4_transform(m, v);
+}
+
+void scalarTransformDirection(float* m, float* v) {
+  mat4_transformDirection(m, v);
+}
@@ -0,0 +1,210 @@
+// Checks the SSE or NEON matrix kernels in maf.h against the scalar ones on random matrices, then
+// measures how much faster they are.  Multiplies and transforms add in the same order as the scalar
+// code, so they have to match exactly (build with -ffp-contract=off so the compiler doesn't fuse
+// them).  The SSE inverse is computed differently, so it only has to match to rounding error.
+
+#include "core/maf.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+#define COUNT 100000
+
+void scalarMultiply(float* m, float* n);
+void scalarMultiplyVec4(float* m, float* v);
+void scalarInvert(float* m);
+void scalarTransform(float* m, float* v);
+void scalarTransformDirection(float* m, float* v);
+
+static uint32_t seed = 1;
+
+static float randomFloat(float min, float max) {
+  seed = seed * 1664525 + 1013904223;
+  return min + (seed >> 8) / 16777216.f * (max - min);
+}
+
+static double getTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Transforms like the ones the engine uses: rotation, scale, and translation
+static void randomTransform(float* m) {
+  mat4_identity(m);
+  mat4_translate(m, randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f));
+  mat4_rotate(m, randomFloat(-4.f, 4.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(.1f, 1.f));
+  mat4_scale(m, randomFloat(.1f, 10.f), randomFloat(.1f, 10.f), randomFloat(.1f, 10.f));
+}
+
+// Any 4x4 matrix, with a heavy diagonal so it stays invertible
+static void randomMatrix(float* m) {
+  for (int i = 0; i < 16; i++) {
+    m[i] = randomFloat(-1.f, 1.f) + (i % 5 == 0 ? 4.f : 0.f);
+  }
+}
+
+static void randomVector(float* v) {
+  for (int i = 0; i < 3; i++) {
+    v[i] = randomFloat(-100.f, 100.f);
+  }
+  v[3] = 1.f;
+}
+
+// How far an inverse is from the scalar one, relative to the size of the entries
+static float inverseError(float* m, float* expected) {
+  float scale = 0.f;
+  float error = 0.f;
+  for (int i = 0; i < 16; i++) {
+    scale = fmaxf(scale, fabsf(expected[i]));
+    error = fmaxf(error, fabsf(m[i] - expected[i]));
+  }
+  return error / fmaxf(scale, 1.f);
+}
+
+static void checkMatrices(float* a, float* b) {
+  float m[16], n[16], v[4], w[4];
+
+  memcpy(m, a, sizeof(m));
+  memcpy(n, a, sizeof(n));
+  mat4_multiply(m, b);
+  scalarMultiply(n, b);
+  CHECK(!memcmp(m, n, sizeof(m)));
+
+  // Multiplying a matrix by itself, where the output aliases the input
+  memcpy(m, a, sizeof(m));
+  memcpy(n, a, sizeof(n));
+  mat4_multiply(m, m);
+  scalarMultiply(n, n);
+  CHECK(!memcmp(m, n, sizeof(m)));
+
+  randomVector(v);
+  memcpy(w, v, sizeof(w));
+  mat4_multiplyVec4(a, v);
+  scalarMultiplyVec4(a, w);
+  CHECK(!memcmp(v, w, sizeof(v)));
+
+  randomVector(v);
+  memcpy(w, v, sizeof(w));
+  mat4_transform(a, v);
+  scalarTransform(a, w);
+  CHECK(!memcmp(v, w, sizeof(v)));
+
+  randomVector(v);
+  memcpy(w, v, sizeof(w));
+  mat4_transformDirection(a, v);
+  scalarTransformDirection(a, w);
+  CHECK(!memcmp(v, w, sizeof(v)));
+}
+
+static float checkInverse(float* a) {
+  float m[16], n[16];
+  memcpy(m, a, sizeof(m));
+  memcpy(n, a, sizeof(n));
+  mat4_invert(m);
+  scalarInvert(n);
+  float error = inverseError(m, n);
+  CHECK(error < 1e-4f);
+
+  // The inverse times the original should be close to the identity
+  mat4_multiply(m, a);
+  for (int i = 0; i < 16; i++) {
+    CHECK(fabsf(m[i] - (i % 5 == 0 ? 1.f : 0.f)) < 1e-3f);
+  }
+
+  return error;
+}
+
+static void check(void) {
+  float a[16], b[16];
+  float worst = 0.f;
+
+  for (int i = 0; i < COUNT; i++) {
+    randomTransform(a);
+    randomTransform(b);
+    checkMatrices(a, b);
+    worst = fmaxf(worst, checkInverse(a));
+
+    randomMatrix(a);
+    randomMatrix(b);
+    checkMatrices(a, b);
+    worst = fmaxf(worst, checkInverse(a));
+  }
+
+  // Singular matrices are left alone by both
+  float zero[16] = { 0 };
+  float m[16] = { 0 };
+  mat4_invert(m);
+  CHECK(!memcmp(m, zero, sizeof(m)));
+  scalarInvert(m);
+  CHECK(!memcmp(m, zero, sizeof(m)));
+
+  printf("ok %d transforms and %d matrices, worst relative inverse error %g\n", COUNT, COUNT, worst);
+}
+
+// Every call works on a fresh copy of one of the inputs, so the copy is included in both timings.
+// Each kernel is timed a few times and the fastest run is kept, to filter out noise.
+typedef void Kernel(float* m, float* n, float* out);
+
+static volatile float sink;
+
+static void bench(const char* name, Kernel* simd, Kernel* scalar) {
+  enum { N = 1024, ROUNDS = 500, RUNS = 5 };
+  static float a[N][16];
+  static float b[N][16];
+  float out[16];
+  double times[2];
+  float sum = 0.f;
+
+  for (int i = 0; i < N; i++) {
+    randomTransform(a[i]);
+    randomTransform(b[i]);
+    randomVector(b[i]);
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    Kernel* kernel = pass == 0 ? simd : scalar;
+    times[pass] = INFINITY;
+    for (int run = 0; run < RUNS; run++) {
+      double start = getTime();
+      for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < N; i++) {
+          kernel(a[i], b[(i + r) % N], out);
+          sum += out[0];
+        }
+      }
+      times[pass] = fmin(times[pass], getTime() - start);
+    }
+  }
+
+  sink = sum;
+  double count = (double) N * ROUNDS;
+  printf("%-18s %6.2f ns simd %6.2f ns scalar (%4.2fx)\n", name, times[0] / count * 1e9,
+    times[1] / count * 1e9, times[1] / times[0]);
+}
+
+static void multiplySimd(float* m, float* n, float* out) { memcpy(out, m, 64); mat4_multiply(out, n); }
+static void multiplyScalar(float* m, float* n, float* out) { memcpy(out, m, 64); scalarMultiply(out, n); }
+static void invertSimd(float* m, float* n, float* out) { memcpy(out, m, 64); mat4_invert(out); }
+static void invertScalar(float* m, float* n, float* out) { memcpy(out, m, 64); scalarInvert(out); }
+static void transformSimd(float* m, float* n, float* out) { memcpy(out, n, 16); mat4_transform(m, out); }
+static void transformScalar(float* m, float* n, float* out) { memcpy(out, n, 16); scalarTransform(m, out); }
+static void multiplyVec4Simd(float* m, float* n, float* out) { memcpy(out, n, 16); mat4_multiplyVec4(m, out); }
+static void multiplyVec4Scalar(float* m, float* n, float* out) { memcpy(out, n, 16); scalarMultiplyVec4(m, out); }
+
+int main(void) {
+#if !defined(MAF_SSE) && !defined(MAF_NEON)
+  printf("skipped, this target has no SIMD path\n");
+  return 0;
+#endif
+  check();
+  bench("mat4_multiply", multiplySimd, multiplyScalar);
+  bench("mat4_invert", invertSimd, invertScalar);
+  bench("mat4_transform", transformSimd, transformScalar);
+  bench("mat4_multiplyVec4", multiplyVec4Simd, multiplyVec4Scalar);
+  return 0;
+}
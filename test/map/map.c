@@ -0,0 +1,163 @@
+// Runs random sets, gets and removes on a map_t and checks every result against a plain array, then
+// measures lookups in a map with 100,000 keys.  Half of the keys share their low bits, so they all
+// want the same few slots and build the long probe sequences that removal has to shift back.
+
+#include "core/map.h"
+#include "core/hash.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+#define KEYS 4096
+#define OPERATIONS 2000000
+#define LOOKUPS 100000
+
+void lovrThrow(const char* format, ...) {
+  puts(format);
+  abort();
+}
+
+static uint64_t seed = 1;
+
+static uint32_t randomInt(uint32_t n) {
+  seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+  return (uint32_t) (seed >> 33) % n;
+}
+
+static double getTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static uint64_t keys[KEYS];
+static uint64_t values[KEYS];
+static bool present[KEYS];
+static uint32_t count;
+
+static void checkAll(map_t* map) {
+  CHECK(map->used == count);
+  for (uint32_t i = 0; i < KEYS; i++) {
+    CHECK(map_get(map, keys[i]) == (present[i] ? values[i] : MAP_NIL));
+  }
+}
+
+static void check(void) {
+  for (uint32_t i = 0; i < KEYS; i++) {
+    keys[i] = i % 2 ? hash64(&i, sizeof(i)) : ((uint64_t) i << 32) | 7;
+  }
+
+  map_t map;
+  map_init(&map, 0);
+
+  // Phases that mostly grow, mostly shrink, and churn, so the map sees every load factor
+  uint32_t weights[][3] = { { 70, 10, 20 }, { 20, 60, 20 }, { 40, 40, 20 } };
+
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    uint32_t* weight = weights[(i / 100000) % 3];
+    uint32_t k = randomInt(KEYS);
+    uint32_t op = randomInt(100);
+
+    if (op < weight[0]) {
+      uint64_t value = randomInt(1000000);
+      map_set(&map, keys[k], value);
+      count += !present[k];
+      present[k] = true;
+      values[k] = value;
+    } else if (op < weight[0] + weight[1]) {
+      map_remove(&map, keys[k]);
+      count -= present[k];
+      present[k] = false;
+    } else {
+      CHECK(map_get(&map, keys[k]) == (present[k] ? values[k] : MAP_NIL));
+    }
+
+    if (i % 10000 == 0) {
+      checkAll(&map);
+    }
+  }
+
+  checkAll(&map);
+
+  // Removing everything leaves an empty table, and it still works afterwards
+  for (uint32_t i = 0; i < KEYS; i++) {
+    map_remove(&map, keys[i]);
+    count -= present[i];
+    present[i] = false;
+  }
+  checkAll(&map);
+  for (uint32_t i = 0; i < map.size; i++) {
+    CHECK(map.hashes[i] == MAP_NIL);
+  }
+  map_set(&map, keys[0], 1);
+  CHECK(map_get(&map, keys[0]) == 1);
+
+  map_free(&map);
+  printf("ok %d operations on %d keys\n", OPERATIONS, KEYS);
+}
+
+static void bench(void) {
+  static uint64_t hashes[LOOKUPS];
+  static uint64_t misses[LOOKUPS];
+  char name[32];
+
+  double start = getTime();
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    int length = snprintf(name, sizeof(name), "key%u", i);
+    hashes[i] = hash64(name, length);
+    length = snprintf(name, sizeof(name), "missing%u", i);
+    misses[i] = hash64(name, length);
+  }
+  double hashTime = getTime() - start;
+
+  map_t map;
+  map_init(&map, 0);
+  start = getTime();
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    map_set(&map, hashes[i], i);
+  }
+  double setTime = getTime() - start;
+
+  // Looked up in a shuffled order so the hits don't walk the table in memory order
+  for (uint32_t i = LOOKUPS - 1; i > 0; i--) {
+    uint32_t j = randomInt(i + 1);
+    uint64_t t = hashes[i];
+    hashes[i] = hashes[j];
+    hashes[j] = t;
+  }
+
+  uint64_t sum = 0;
+  start = getTime();
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    sum += map_get(&map, hashes[i]);
+  }
+  double hitTime = getTime() - start;
+  CHECK(sum == (uint64_t) LOOKUPS * (LOOKUPS - 1) / 2);
+
+  start = getTime();
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    CHECK(map_get(&map, misses[i]) == MAP_NIL);
+  }
+  double missTime = getTime() - start;
+
+  start = getTime();
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    map_remove(&map, hashes[i]);
+  }
+  double removeTime = getTime() - start;
+  CHECK(map.used == 0);
+  map_free(&map);
+
+  printf("%d keys: hash %.1f ns, set %.1f ns, hit %.1f ns, miss %.1f ns, remove %.1f ns\n", LOOKUPS,
+    hashTime / (2 * LOOKUPS) * 1e9, setTime / LOOKUPS * 1e9, hitTime / LOOKUPS * 1e9,
+    missTime / LOOKUPS * 1e9, removeTime / LOOKUPS * 1e9);
+}
+
+int main(void) {
+  check();
+  bench();
+  return 0;
+}
@@ -0,0 +1,10 @@
+function lovr.conf(t)
+  t.identity = 'lovr-test-threads'
+  t.modules.headset = false
+  t.modules.audio = false
+  t.modules.graphics = false
+  t.modules.physics = false
+
+  -- POOL=0 starts every Thread on a new thread with a new Lua state, for comparison
+  t.thread.pool = tonumber(os.getenv('POOL') or 1)
+end
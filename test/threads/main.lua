@@ -0,0 +1,99 @@
+-- Checks that Threads running on the pool don't see each other's globals or modules, then measures
+-- how long it takes to start a Thread and wait on it.  With the default pool of one host, every
+-- Thread here runs on the same Lua state.  Run with POOL=0 to compare against creating a thread and
+-- a Lua state for every start.
+
+local leak = [[
+  x = 1
+  rawset(_G, 'y', 2)
+  print = 'not print'
+  package.loaded.helper = {}
+  package.loaded.lovrutils = {}
+  require('lovr.thread').marker = true
+  setmetatable(_G, { __index = function() return 3 end })
+]]
+
+-- The lovr modules stay loaded, so a field set on one sticks if the Threads share a host
+local check = [[
+  local shared = ...
+  local thread = require('lovr.thread')
+  local problems = {}
+  if rawget(_G, 'x') ~= nil or x ~= nil then problems[#problems + 1] = 'global x' end
+  if rawget(_G, 'y') ~= nil then problems[#problems + 1] = 'rawset global y' end
+  if type(print) ~= 'function' then problems[#problems + 1] = 'print was replaced' end
+  if getmetatable(_G) then problems[#problems + 1] = 'metatable on _G' end
+  if package.loaded.helper then problems[#problems + 1] = 'module helper' end
+  if package.loaded.lovrutils then problems[#problems + 1] = 'module lovrutils' end
+  if not package.loaded['lovr.thread'] then problems[#problems + 1] = 'lovr.thread was unloaded' end
+  if shared and not thread.marker then problems[#problems + 1] = 'lovr.thread was reloaded' end
+  thread.getChannel('check'):push(table.concat(problems, ', '))
+]]
+
+-- A body that takes a while to compile, so the chunk cache makes a difference
+local function bigBody()
+  local lines = { 'local t = {}' }
+  for i = 1, 500 do
+    lines[#lines + 1] = ('t[%d] = function(a, b) if a > b then return a * %d else return b - %d end end'):format(i, i, i)
+  end
+  return table.concat(lines, '\n')
+end
+
+local function fail(message)
+  print('FAIL: ' .. message)
+  lovr.event.quit(1)
+end
+
+local pool = tonumber(os.getenv('POOL') or 1)
+
+local function run(thread, ...)
+  thread:start(...)
+  thread:wait()
+  local err = thread:getError()
+  if err then error(err) end
+end
+
+local function time(n, fn)
+  local start = lovr.timer.getTime()
+  for i = 1, n do fn(i) end
+  return (lovr.timer.getTime() - start) / n * 1e6
+end
+
+function lovr.load()
+  local channel = lovr.thread.getChannel('check')
+  for i = 1, 3 do
+    run(lovr.thread.newThread(leak))
+    run(lovr.thread.newThread(check), pool == 1)
+    local problems = channel:pop()
+    if problems ~= '' then
+      return fail('state leaked between Threads: ' .. problems)
+    end
+  end
+
+  -- Compile errors aren't cached, and don't break the host
+  local broken = lovr.thread.newThread('this is not lua\n')
+  for i = 1, 2 do
+    broken:start()
+    broken:wait()
+    if not broken:getError() then
+      return fail('a Thread with a syntax error did not report it')
+    end
+  end
+  lovr.event.clear()
+  run(lovr.thread.newThread(check), pool == 1)
+  if channel:pop() ~= '' then
+    return fail('a syntax error left the host in a bad state')
+  end
+
+  local empty = lovr.thread.newThread('\n')
+  local code = bigBody()
+  local big = lovr.thread.newThread(code)
+  local n = 200
+
+  local emptyTime = time(n, function() run(empty) end)
+  local cachedTime = time(n, function() run(big) end)
+  local uncachedTime = time(n, function() run(lovr.thread.newThread(code)) end)
+
+  print(('ok: start and wait takes %.1fus for an empty Thread, %.1fus for a big one, %.1fus for a new big one every time (pool of %d)'):format(
+    emptyTime, cachedTime, uncachedTime, pool))
+  lovr.event.quit(0)
+end
@@ -0,0 +1,130 @@
+// Mounts each archive written by archives.py and checks that its files read back correctly through
+// Read, Map and FileReader.  big.zip is only checked if it's there.
+
+#include "filesystem/filesystem.h"
+#include "core/ref.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+void lovrThrow(const char* format, ...) {
+  puts(format);
+  abort();
+}
+
+static unsigned char payload[800000];
+
+static void checkArchive(const char* archive) {
+  size_t size;
+  unsigned char* data;
+  CHECK(lovrFilesystemMount(archive, "m", true, NULL));
+
+  data = lovrFilesystemRead("m/a/stored.bin", -1, &size);
+  CHECK(data && size == sizeof(payload) && !memcmp(data, payload, size));
+  free(data);
+
+  data = lovrFilesystemRead("m/a/deflated.bin", -1, &size);
+  CHECK(data && size == sizeof(payload) && !memcmp(data, payload, size));
+  free(data);
+
+  data = lovrFilesystemRead("m/a/deflated.bin", 1000, &size);
+  CHECK(data && size == 1000 && !memcmp(data, payload, size));
+  free(data);
+
+  // Stored files can be mapped, compressed ones can't without the cache
+  FileMapping* mapping = NULL;
+  void* view = lovrFilesystemMap("m/a/stored.bin", &size, &mapping);
+  CHECK(view && mapping && size == sizeof(payload) && !memcmp(view, payload, size));
+  FileMapping* other = NULL;
+  CHECK(!lovrFilesystemMap("m/a/deflated.bin", &size, &other));
+
+  // The streaming inflater, read in chunks that don't line up with anything, then seeking around
+  FileReader* reader = lovrFilesystemOpenReader("m/a/deflated.bin");
+  CHECK(reader && lovrFileReaderGetSize(reader) == sizeof(payload));
+  unsigned char buffer[7001];
+  size_t total = 0;
+  size_t count;
+  while ((count = lovrFileReaderRead(reader, buffer, sizeof(buffer))) > 0) {
+    CHECK(total + count <= sizeof(payload) && !memcmp(buffer, payload + total, count));
+    total += count;
+  }
+  CHECK(total == sizeof(payload));
+  CHECK(lovrFileReaderSeek(reader, 12345));
+  CHECK(lovrFileReaderRead(reader, buffer, 100) == 100 && !memcmp(buffer, payload + 12345, 100));
+  CHECK(lovrFileReaderSeek(reader, 700000));
+  CHECK(lovrFileReaderRead(reader, buffer, 100) == 100 && !memcmp(buffer, payload + 700000, 100));
+  lovrFileReaderClose(reader);
+
+  // Mappings keep the archive alive after it's unmounted
+  CHECK(lovrFilesystemUnmount(archive));
+  CHECK(!memcmp(view, payload, 1000));
+  lovrRelease(FileMapping, mapping);
+  printf("ok %s\n", archive);
+}
+
+static void checkMany(void) {
+  CHECK(lovrFilesystemMount("many.zip", NULL, true, NULL));
+  for (int i = 0; i < 70000; i += 997) {
+    char path[64];
+    char expected[128];
+    snprintf(path, sizeof(path), "d%d/f%d.txt", i % 100, i);
+    snprintf(expected, sizeof(expected), "file %d file %d file %d ", i, i, i);
+    size_t size;
+    char* data = lovrFilesystemRead(path, -1, &size);
+    CHECK(data && size == strlen(expected) && !memcmp(data, expected, size));
+    free(data);
+  }
+  CHECK(lovrFilesystemIsFile("d99/f69999.txt"));
+  CHECK(lovrFilesystemIsDirectory("d0"));
+  CHECK(lovrFilesystemUnmount("many.zip"));
+  printf("ok many.zip\n");
+}
+
+static void checkBig(void) {
+  FILE* file = fopen("big.zip", "rb");
+  if (!file) {
+    printf("skipped big.zip\n");
+    return;
+  }
+  fclose(file);
+
+  size_t size;
+  CHECK(lovrFilesystemMount("big.zip", NULL, true, NULL));
+  CHECK(lovrFilesystemGetSize("huge.bin") == 260ull << 24);
+
+  char* data = lovrFilesystemRead("after.txt", -1, &size);
+  CHECK(data && size == 18 && !memcmp(data, "after the big file", 18));
+  free(data);
+
+  FileMapping* mapping;
+  char* view = lovrFilesystemMap("after_stored.txt", &size, &mapping);
+  CHECK(view && size == 25 && !memcmp(view, "stored after the big file", 25));
+  lovrRelease(FileMapping, mapping);
+
+  char buffer[16];
+  FileReader* reader = lovrFilesystemOpenReader("huge.bin");
+  CHECK(reader && lovrFileReaderSeek(reader, (260ull << 24) - 10));
+  CHECK(lovrFileReaderRead(reader, buffer, sizeof(buffer)) == 10);
+  lovrFileReaderClose(reader);
+
+  CHECK(lovrFilesystemUnmount("big.zip"));
+  printf("ok big.zip\n");
+}
+
+int main(int argc, char** argv) {
+  FILE* file = fopen("payload.bin", "rb");
+  CHECK(file && fread(payload, 1, sizeof(payload), file) == sizeof(payload));
+  fclose(file);
+
+  CHECK(lovrFilesystemInit(NULL, NULL, NULL));
+  checkArchive("comment.zip");
+  checkArchive("sfx.zip");
+  checkArchive("zip64.zip");
+  checkArchive("sfx64.zip");
+  checkMany();
+  checkBig();
+  lovrFilesystemDestroy();
+  return 0;
+}
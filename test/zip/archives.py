@@ -0,0 +1,72 @@
+# Writes the archives that archives.c reads, along with payload.bin (the contents of the files in
+# them).  Pass --big to also write big.zip, which is over 4GB.
+import random, struct, sys, zipfile, zlib
+
+random.seed(1)
+payload = bytes(random.getrandbits(8) for _ in range(200000)) + b'hello world ' * 50000
+with open('payload.bin', 'wb') as f:
+  f.write(payload)
+
+# A comment after the endOfCentralDirectory, so it has to be searched for
+with zipfile.ZipFile('comment.zip', 'w') as z:
+  z.writestr('a/stored.bin', payload, compress_type=zipfile.ZIP_STORED)
+  z.writestr('a/deflated.bin', payload, compress_type=zipfile.ZIP_DEFLATED)
+  z.comment = b'PK trailing comment ' * 100
+
+# Self-extracting archives have an executable in front, so none of the offsets are right
+with open('comment.zip', 'rb') as f:
+  data = f.read()
+with open('sfx.zip', 'wb') as f:
+  f.write(b'\x7fELF' + b'\0' * 5000 + data)
+
+# More files than fit in the endOfCentralDirectory, so zipfile writes a Zip64 record for the count
+with zipfile.ZipFile('many.zip', 'w') as z:
+  for i in range(70000):
+    method = zipfile.ZIP_DEFLATED if i % 2 else zipfile.ZIP_STORED
+    z.writestr('d%d/f%d.txt' % (i % 100, i), ('file %d ' % i) * 3, compress_type=method)
+
+# zipfile only uses Zip64 fields for things that don't fit, so this one is written by hand with all
+# of the sizes and offsets in Zip64 extra fields.  The first file also has an unrelated extra field
+# before the Zip64 one.
+def zip64(path, entries, prefix=b''):
+  out = bytearray()
+  central = bytearray()
+  for i, (name, method, data) in enumerate(entries):
+    if method == zipfile.ZIP_DEFLATED:
+      deflate = zlib.compressobj(6, zlib.DEFLATED, -15)
+      compressed = deflate.compress(data) + deflate.flush()
+    else:
+      compressed = data
+    crc = zlib.crc32(data)
+    name = name.encode()
+    offset = len(out)
+    extra = struct.pack('<HHQQ', 0x0001, 16, len(data), len(compressed))
+    out += struct.pack('<IHHHHHIIIHH', 0x04034b50, 45, 0, method, 0, 0x21, crc, 0xffffffff, 0xffffffff, len(name), len(extra))
+    out += name + extra + compressed
+    extra = struct.pack('<HHQQQ', 0x0001, 24, len(data), len(compressed), offset)
+    if i == 0:
+      extra = struct.pack('<HHI', 0x5455, 4, 0) + extra
+    central += struct.pack('<IHHHHHHIIIHHHHHII', 0x02014b50, 45, 45, 0, method, 0, 0x21, crc, 0xffffffff, 0xffffffff, len(name), len(extra), 0, 0, 0, 0, 0xffffffff)
+    central += name + extra
+  start = len(out)
+  out += central
+  record = len(out)
+  out += struct.pack('<IQHHIIQQQQ', 0x06064b50, 44, 45, 45, 0, 0, len(entries), len(entries), len(central), start)
+  out += struct.pack('<IIQI', 0x07064b50, 0, record, 1)
+  out += struct.pack('<IHHHHIIH', 0x06054b50, 0, 0, 0xffff, 0xffff, 0xffffffff, 0xffffffff, 0)
+  with open(path, 'wb') as f:
+    f.write(prefix + out)
+
+entries = [('a/stored.bin', zipfile.ZIP_STORED, payload), ('a/deflated.bin', zipfile.ZIP_DEFLATED, payload)]
+zip64('zip64.zip', entries)
+zip64('sfx64.zip', entries, b'\x7fELF' + b'\0' * 5000)
+
+# Offsets past 4GB: one big stored file of zeros, then small files after it
+if '--big' in sys.argv:
+  with zipfile.ZipFile('big.zip', 'w', allowZip64=True) as z:
+    with z.open(zipfile.ZipInfo('huge.bin'), 'w', force_zip64=True) as f:
+      chunk = b'\0' * (1 << 24)
+      for i in range(260):
+        f.write(chunk)
+    z.writestr('after.txt', b'after the big file', compress_type=zipfile.ZIP_DEFLATED)
+    z.writestr('after_stored.txt', b'stored after the big file', compress_type=zipfile.ZIP_STORED)
@@ -0,0 +1,131 @@
+// Checks that every compression method in methods.zip (see methods.py) decodes correctly through
+// each way of reading a file, then measures how fast the whole corpus decodes with each method.
+// The argument is the number of times to read each corpus, the best time is reported.
+
+#include "filesystem/filesystem.h"
+#include "core/ref.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHECK(c) if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1); }
+
+void lovrThrow(const char* format, ...) {
+  puts(format);
+  abort();
+}
+
+static double getTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned char* readFile(const char* path, size_t* size) {
+  FILE* file = fopen(path, "rb");
+  CHECK(file);
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  unsigned char* data = malloc(*size);
+  CHECK(data && fread(data, 1, *size, file) == *size);
+  fclose(file);
+  return data;
+}
+
+static void checkFile(const char* path, const unsigned char* expected, size_t size) {
+  size_t count;
+  unsigned char* data = lovrFilesystemRead(path, -1, &count);
+  CHECK(data || size == 0);
+  CHECK(count == size && !memcmp(data, expected, size));
+  free(data);
+
+  // Partial reads stop decoding early
+  data = lovrFilesystemRead(path, size / 3, &count);
+  CHECK(count == size / 3 && !memcmp(data, expected, count));
+  free(data);
+
+  FileReader* reader = lovrFilesystemOpenReader(path);
+  CHECK(reader && lovrFileReaderGetSize(reader) == size);
+  unsigned char buffer[5000];
+  size_t total = 0;
+  while ((count = lovrFileReaderRead(reader, buffer, sizeof(buffer))) > 0) {
+    CHECK(total + count <= size && !memcmp(buffer, expected + total, count));
+    total += count;
+  }
+  CHECK(total == size);
+
+  if (size > 100) {
+    CHECK(lovrFileReaderSeek(reader, 50));
+    CHECK(lovrFileReaderRead(reader, buffer, 10) == 10 && !memcmp(buffer, expected + 50, 10));
+  }
+  lovrFileReaderClose(reader);
+}
+
+int main(int argc, char** argv) {
+  int reps = argc > 1 ? atoi(argv[1]) : 10;
+  const char* methods[] = { "store", "deflate", "zstd", "lz4" };
+
+  size_t corpusSize;
+  unsigned char* corpus = readFile("corpus.bin", &corpusSize);
+  size_t smallSize = corpusSize < 100000 ? corpusSize : 100000;
+  size_t oddSize = smallSize < 77777 ? smallSize : 77777;
+
+  unsigned char* runs = malloc(670000);
+  for (int i = 0; i < 600000; i++) {
+    runs[i] = "ab"[i & 1];
+  }
+  memset(runs + 600000, 'z', 70000);
+
+  CHECK(lovrFilesystemInit(NULL, NULL, NULL));
+  CHECK(lovrFilesystemMount("methods.zip", NULL, true, NULL));
+
+  for (int i = 0; i < 4; i++) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/corpus", methods[i]);
+    checkFile(path, corpus, corpusSize);
+    snprintf(path, sizeof(path), "%s/small", methods[i]);
+    checkFile(path, corpus, smallSize);
+    snprintf(path, sizeof(path), "%s/odd", methods[i]);
+    checkFile(path, corpus, oddSize);
+    snprintf(path, sizeof(path), "%s/empty", methods[i]);
+    checkFile(path, corpus, 0);
+    snprintf(path, sizeof(path), "%s/runs", methods[i]);
+    checkFile(path, runs, 670000);
+
+    // Stored files are mapped directly, everything else goes through the cache
+    snprintf(path, sizeof(path), "%s/corpus", methods[i]);
+    const char* paths[] = { path };
+    size_t size;
+    FileMapping* mapping;
+    lovrFilesystemSetCacheBudget(corpusSize * 2);
+    CHECK(lovrFilesystemPrefetch(paths, 1) == (i == 0 ? 0 : 1));
+    void* data = lovrFilesystemMap(path, &size, &mapping);
+    CHECK(data && size == corpusSize && !memcmp(data, corpus, size));
+    lovrRelease(FileMapping, mapping);
+    lovrFilesystemSetCacheBudget(0);
+  }
+
+  printf("ok methods.zip\n");
+
+  for (int i = 0; i < 4; i++) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/corpus", methods[i]);
+    double best = 1e9;
+    for (int j = 0; j < reps; j++) {
+      size_t size;
+      double start = getTime();
+      void* data = lovrFilesystemRead(path, -1, &size);
+      double time = getTime() - start;
+      free(data);
+      best = time < best ? time : best;
+    }
+    printf("%-8s %8.1f MB/s (%.2fms for %.1fMB)\n", methods[i], corpusSize / best / 1e6, best * 1e3, corpusSize / 1e6);
+  }
+
+  lovrFilesystemDestroy();
+  free(corpus);
+  free(runs);
+  return 0;
+}
@@ -0,0 +1,67 @@
+# Writes methods.zip, which has the same files stored, deflated, and compressed with zstd and LZ4,
+# along with corpus.bin (the uncompressed corpus) for bench.c to compare against.  The corpus is
+# the file given on the command line, or all of LÖVR's source.  Needs the zstd and lz4 tools.
+import os, struct, subprocess, sys, zlib
+
+STORE, DEFLATE, ZSTD, LZ4 = 0, 8, 93, 0x4c34
+
+def compress(method, data):
+  if method == STORE:
+    return data
+  if method == DEFLATE:
+    deflate = zlib.compressobj(6, zlib.DEFLATED, -15)
+    return deflate.compress(data) + deflate.flush()
+  if method == ZSTD:
+    return subprocess.run(['zstd', '-3', '-c', '-q'], input=data, capture_output=True, check=True).stdout
+  if method == LZ4:
+    # Odd sized files use dependent blocks, so both kinds of frame get tested
+    flags = ['-BD'] if len(data) % 2 else []
+    return subprocess.run(['lz4', '-c', '-q', '--content-size'] + flags, input=data, capture_output=True, check=True).stdout
+
+# zipfile can't write methods it doesn't know about, so the archive is put together by hand
+def write(path, entries):
+  out = bytearray()
+  central = bytearray()
+  for name, method, data in entries:
+    compressed = compress(method, data)
+    crc = zlib.crc32(data)
+    name = name.encode()
+    offset = len(out)
+    out += struct.pack('<IHHHHHIIIHH', 0x04034b50, 63, 0, method, 0, 0x21, crc, len(compressed), len(data), len(name), 0)
+    out += name + compressed
+    central += struct.pack('<IHHHHHHIIIHHHHHII', 0x02014b50, 63, 63, 0, method, 0, 0x21, crc, len(compressed), len(data), len(name), 0, 0, 0, 0, 0, offset)
+    central += name
+  start = len(out)
+  out += central
+  out += struct.pack('<IHHHHIIH', 0x06054b50, 0, 0, len(entries), len(entries), len(central), start, 0)
+  with open(path, 'wb') as f:
+    f.write(out)
+
+if len(sys.argv) > 1:
+  with open(sys.argv[1], 'rb') as f:
+    corpus = f.read()
+else:
+  root = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'src')
+  corpus = bytearray()
+  for directory, folders, files in sorted(os.walk(root)):
+    folders.sort()
+    for name in sorted(files):
+      with open(os.path.join(directory, name), 'rb') as f:
+        corpus += f.read()
+  corpus = bytes(corpus)
+
+small = corpus[:100000]
+runs = b'ab' * 300000 + b'z' * 70000
+
+entries = []
+for method, tag in ((STORE, 'store'), (DEFLATE, 'deflate'), (ZSTD, 'zstd'), (LZ4, 'lz4')):
+  entries.append((tag + '/corpus', method, corpus))
+  entries.append((tag + '/small', method, small))
+  entries.append((tag + '/odd', method, small[:77777]))
+  entries.append((tag + '/empty', method, b''))
+  entries.append((tag + '/runs', method, runs))
+
+write('methods.zip', entries)
+with open('corpus.bin', 'wb') as f:
+  f.write(corpus)
+print('corpus is %d bytes' % len(corpus))